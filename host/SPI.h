@@ -0,0 +1,35 @@
+#pragma once
+
+// Host stand-in for the Arduino SPI library. Bytes are routed to the simulated
+// bus, which decides the addressed device from the chip select pins.
+
+#include <Arduino.h>
+
+#define SPI_CLOCK_DIV4 0x00
+#define SPI_CLOCK_DIV16 0x01
+#define SPI_CLOCK_DIV64 0x02
+#define SPI_CLOCK_DIV128 0x03
+#define SPI_CLOCK_DIV2 0x04
+#define SPI_CLOCK_DIV8 0x05
+#define SPI_CLOCK_DIV32 0x06
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+#define SPI_MODE_MASK 0x0C
+#define SPI_CLOCK_MASK 0x03
+#define SPI_2XCLOCK_MASK 0x01
+
+class SPIClass {
+public:
+	static void begin();
+	static void end();
+	static uint8_t transfer(uint8_t data);
+	static void setBitOrder(uint8_t bitOrder);
+	static void setDataMode(uint8_t dataMode);
+	static void setClockDivider(uint8_t clockDiv);
+};
+
+extern SPIClass SPI;
@@ -0,0 +1,23 @@
+#pragma once
+
+// Host stand-in for <avr/eeprom.h>, implemented on top of the simulated
+// EECR/EEDR/EEAR registers like avr-libc does.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint8_t eeprom_read_byte(const uint8_t* addr);
+void eeprom_write_byte(uint8_t* addr, uint8_t value);
+void eeprom_update_byte(uint8_t* addr, uint8_t value);
+void eeprom_read_block(void* dst, const void* src, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define eeprom_is_ready() (!(EECR & _BV(EEPE)))
+#define eeprom_busy_wait() do {} while (!eeprom_is_ready())
@@ -0,0 +1,29 @@
+#pragma once
+
+// Host stand-in for <avr/interrupt.h>. Vectors are plain functions picked up
+// by the simulator, which calls them with the I flag cleared like the hardware.
+
+#include <avr/io.h>
+
+#define HOST_VECTOR(name) host_vect_##name
+
+#define INT0_vect			HOST_VECTOR(INT0)
+#define INT1_vect			HOST_VECTOR(INT1)
+#define INT2_vect			HOST_VECTOR(INT2)
+#define INT3_vect			HOST_VECTOR(INT3)
+#define INT6_vect			HOST_VECTOR(INT6)
+#define TIMER0_COMPA_vect	HOST_VECTOR(TIMER0_COMPA)
+#define TIMER0_OVF_vect		HOST_VECTOR(TIMER0_OVF)
+#define ADC_vect			HOST_VECTOR(ADC)
+#define EE_READY_vect		HOST_VECTOR(EE_READY)
+#define TIMER3_COMPA_vect	HOST_VECTOR(TIMER3_COMPA)
+
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+#define ISR(vector, ...) extern "C" void vector(void); extern "C" void vector(void)
+
+extern "C" void host_sei(void);
+extern "C" void host_cli(void);
+
+#define sei() host_sei()
+#define cli() host_cli()
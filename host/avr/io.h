@@ -0,0 +1,303 @@
+#pragma once
+
+// Host stand-in for <avr/io.h> (ATmega32U4 subset used by the firmware).
+// Registers are objects so the simulator can watch accesses and charge cycles.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define _BV(bit) (1 << (bit))
+
+#define E2END		0x3FF
+#define FLASHEND	0x7FFF
+#define RAMSTART	0x100
+#define HOST_SRAM_SIZE	0xA00
+
+#ifdef __cplusplus
+
+extern "C" void host_cycles(uint32_t cycles);
+
+extern uint8_t host_sram[HOST_SRAM_SIZE];
+#define RAMEND ((uintptr_t)(host_sram + HOST_SRAM_SIZE - 1))
+
+template<typename T>
+struct host_reg {
+	typedef void (*write_hook_t)(T old_value);
+	typedef T (*read_hook_t)();
+
+	T value;
+	write_hook_t on_write;
+	read_hook_t on_read;
+
+	T load() const {
+		return on_read ? on_read() : value;
+	}
+	void store(T v) {
+		T old_value = value;
+		value = v;
+		if (on_write)
+			on_write(old_value);
+	}
+
+	// in/out ~1 cycle, read-modify-write ~2 cycles (sbi/cbi or in/ori/out)
+	operator T() const {
+		host_cycles(sizeof(T));
+		return load();
+	}
+	host_reg& operator=(T v) {
+		host_cycles(sizeof(T));
+		store(v);
+		return *this;
+	}
+	host_reg& operator|=(T v) {
+		host_cycles(2 * sizeof(T));
+		store(load() | v);
+		return *this;
+	}
+	host_reg& operator&=(T v) {
+		host_cycles(2 * sizeof(T));
+		store(load() & v);
+		return *this;
+	}
+	host_reg& operator^=(T v) {
+		host_cycles(2 * sizeof(T));
+		store(load() ^ v);
+		return *this;
+	}
+};
+
+#define HOST_REG8(name)		extern host_reg<uint8_t> name
+#define HOST_REG16(name)	extern host_reg<uint16_t> name
+
+HOST_REG8(SREG);
+HOST_REG8(MCUSR);
+HOST_REG8(SMCR);
+HOST_REG8(WDTCSR);
+
+HOST_REG8(PINB);	HOST_REG8(DDRB);	HOST_REG8(PORTB);
+HOST_REG8(PINC);	HOST_REG8(DDRC);	HOST_REG8(PORTC);
+HOST_REG8(PIND);	HOST_REG8(DDRD);	HOST_REG8(PORTD);
+HOST_REG8(PINE);	HOST_REG8(DDRE);	HOST_REG8(PORTE);
+HOST_REG8(PINF);	HOST_REG8(DDRF);	HOST_REG8(PORTF);
+
+HOST_REG8(EIMSK);
+HOST_REG8(EIFR);
+HOST_REG8(EICRA);
+HOST_REG8(EICRB);
+
+HOST_REG8(TCCR0A);
+HOST_REG8(TCCR0B);
+HOST_REG8(TCNT0);
+HOST_REG8(OCR0A);
+HOST_REG8(OCR0B);
+HOST_REG8(TIMSK0);
+HOST_REG8(TIFR0);
+
+HOST_REG8(TCCR1A);
+HOST_REG8(TCCR1B);
+HOST_REG16(OCR1A);
+
+HOST_REG8(TCCR3A);
+HOST_REG8(TCCR3B);
+HOST_REG8(TCCR3C);
+HOST_REG16(TCNT3);
+HOST_REG16(OCR3A);
+HOST_REG8(TIMSK3);
+HOST_REG8(TIFR3);
+
+HOST_REG8(TCCR4A);
+HOST_REG8(TCCR4B);
+HOST_REG8(TCCR4C);
+HOST_REG8(TCCR4D);
+HOST_REG8(OCR4A);
+HOST_REG8(OCR4D);
+
+HOST_REG8(ADMUX);
+HOST_REG8(ADCSRA);
+HOST_REG8(ADCSRB);
+HOST_REG8(DIDR0);
+HOST_REG16(ADC);
+HOST_REG8(ADCL);
+HOST_REG8(ADCH);
+
+HOST_REG8(EECR);
+HOST_REG8(EEDR);
+HOST_REG16(EEAR);
+
+HOST_REG8(SPCR);
+HOST_REG8(SPSR);
+HOST_REG8(SPDR);
+
+#undef HOST_REG8
+#undef HOST_REG16
+
+#endif // __cplusplus
+
+// SREG
+#define SREG_I		7
+
+// SMCR
+#define SM2			3
+#define SM1			2
+#define SM0			1
+#define SE			0
+
+// MCUSR
+#define JTRF		4
+#define WDRF		3
+#define BORF		2
+#define EXTRF		1
+#define PORF		0
+
+// ports
+#define PB7 7
+#define PB6 6
+#define PB5 5
+#define PB4 4
+#define PB3 3
+#define PB2 2
+#define PB1 1
+#define PB0 0
+#define PC7 7
+#define PC6 6
+#define PD7 7
+#define PD6 6
+#define PD5 5
+#define PD4 4
+#define PD3 3
+#define PD2 2
+#define PD1 1
+#define PD0 0
+#define PE6 6
+#define PE2 2
+#define PF7 7
+#define PF6 6
+#define PF5 5
+#define PF4 4
+#define PF1 1
+#define PF0 0
+
+// external interrupts
+#define INT6		6
+#define INT3		3
+#define INT2		2
+#define INT1		1
+#define INT0		0
+#define ISC31		7
+#define ISC30		6
+#define ISC21		5
+#define ISC20		4
+#define ISC11		3
+#define ISC10		2
+#define ISC01		1
+#define ISC00		0
+#define ISC61		5
+#define ISC60		4
+
+// timer 0
+#define COM0A1		7
+#define COM0A0		6
+#define COM0B1		5
+#define COM0B0		4
+#define WGM01		1
+#define WGM00		0
+#define WGM02		3
+#define CS02		2
+#define CS01		1
+#define CS00		0
+#define OCIE0B		2
+#define OCIE0A		1
+#define TOIE0		0
+#define OCF0B		2
+#define OCF0A		1
+#define TOV0		0
+
+// timer 1
+#define COM1A1		7
+#define COM1A0		6
+#define WGM10		0
+#define CS11		1
+#define CS10		0
+
+// timer 3
+#define COM3A1		7
+#define COM3A0		6
+#define COM3B1		5
+#define COM3B0		4
+#define COM3C1		3
+#define COM3C0		2
+#define WGM31		1
+#define WGM30		0
+#define ICNC3		7
+#define ICES3		6
+#define WGM33		4
+#define WGM32		3
+#define CS32		2
+#define CS31		1
+#define CS30		0
+#define FOC3A		7
+#define ICIE3		5
+#define OCIE3C		3
+#define OCIE3B		2
+#define OCIE3A		1
+#define TOIE3		0
+#define ICF3		5
+#define OCF3C		3
+#define OCF3B		2
+#define OCF3A		1
+#define TOV3		0
+
+// timer 4
+#define COM4A1		7
+#define COM4A0		6
+#define PWM4A		1
+#define COM4D1		3
+#define COM4D0		2
+#define PWM4D		0
+
+// ADC
+#define REFS1		7
+#define REFS0		6
+#define ADLAR		5
+#define MUX4		4
+#define MUX3		3
+#define MUX2		2
+#define MUX1		1
+#define MUX0		0
+#define ADEN		7
+#define ADSC		6
+#define ADATE		5
+#define ADIF		4
+#define ADIE		3
+#define ADPS2		2
+#define ADPS1		1
+#define ADPS0		0
+#define ADHSM		7
+#define ACME		6
+#define MUX5		5
+#define ADTS3		3
+#define ADTS2		2
+#define ADTS1		1
+#define ADTS0		0
+#define ADC1D		1
+
+// EEPROM
+#define EEPM1		5
+#define EEPM0		4
+#define EERIE		3
+#define EEMPE		2
+#define EEPE		1
+#define EERE		0
+
+// SPI
+#define SPIE		7
+#define SPE			6
+#define DORD		5
+#define MSTR		4
+#define CPOL		3
+#define CPHA		2
+#define SPR1		1
+#define SPR0		0
+#define SPIF		7
+#define WCOL		6
+#define SPI2X		0
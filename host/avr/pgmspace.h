@@ -0,0 +1,33 @@
+#pragma once
+
+// Host stand-in for <avr/pgmspace.h>. Program memory is ordinary memory on the
+// host, except the fixed addresses the firmware reads from (serial number).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const void* host_pgm_addr(const void* addr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define pgm_read_byte(addr)		(*(const uint8_t*)host_pgm_addr((const void*)(addr)))
+#define pgm_read_word(addr)		(*(addr))
+#define pgm_read_dword(addr)	(*(addr))
+#define pgm_read_ptr(addr)		(*(addr))
+
+#define memcmp_P(s1, s2, n)		memcmp((s1), host_pgm_addr(s2), (n))
+#define memcpy_P(d, s, n)		memcpy((d), host_pgm_addr(s), (n))
+#define strlen_P(s)				strlen((const char*)host_pgm_addr(s))
+#define strncpy_P(d, s, n)		strncpy((d), (const char*)host_pgm_addr(s), (n))
+#define strcpy_P(d, s)			strcpy((d), (const char*)host_pgm_addr(s))
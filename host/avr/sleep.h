@@ -0,0 +1,18 @@
+#pragma once
+
+// Host stand-in for <avr/sleep.h>. sleep_cpu() lets simulated time pass as
+// idle until an interrupt handler has run.
+
+#include <avr/io.h>
+
+#define SLEEP_MODE_IDLE		0
+#define SLEEP_MODE_ADC		_BV(SM0)
+#define SLEEP_MODE_PWR_DOWN	_BV(SM1)
+
+#define set_sleep_mode(mode)	(SMCR = (SMCR & ~(_BV(SM0) | _BV(SM1) | _BV(SM2))) | (mode))
+#define sleep_enable()			(SMCR |= _BV(SE))
+#define sleep_disable()			(SMCR &= ~_BV(SE))
+
+extern "C" void host_sleep(void);
+
+#define sleep_cpu()	host_sleep()
@@ -0,0 +1,29 @@
+#pragma once
+
+// Host stand-in for <avr/wdt.h>. The simulator counts watchdog expiries
+// instead of resetting.
+
+#include <stdint.h>
+
+#define WDTO_15MS	0
+#define WDTO_30MS	1
+#define WDTO_60MS	2
+#define WDTO_120MS	3
+#define WDTO_250MS	4
+#define WDTO_500MS	5
+#define WDTO_1S		6
+#define WDTO_2S		7
+#define WDTO_4S		8
+#define WDTO_8S		9
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void wdt_enable(uint8_t timeout);
+void wdt_disable(void);
+void wdt_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,893 @@
+// Host benchmark: boots the firmware on the simulated board, replays a few
+// user scenarios and reports main loop throughput and where the time goes.
+//
+// usage: bench [-v] [scenario...]	(all scenarios when none is given)
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <Arduino.h>
+#include "sim.h"
+#include "defines.h"
+#include "config.h"
+#include "LiquidCrystal_Prusa.h"
+#include "hardware.h"
+#include "states.h"
+#include "scheduler.h"
+#include "events.h"
+#include "thermistor.h"
+#include "intpol.h"
+
+using namespace Sim;
+
+// main() of the Arduino core: for(;;) loop + serialEventRun check
+#define LOOP_OVERHEAD	12
+
+static bool verbose = false;
+static bool failed = false;		// a scenario pass criterion failed, exit status 1
+
+/*** phase statistics ***/
+
+struct phase_t {
+	const char* name;
+	uint64_t start;
+	counters_t counters;
+	uint32_t iterations;
+	uint64_t loop_max;
+	uint32_t frames;
+	uint32_t frame_bytes;
+};
+static phase_t phase;
+
+static void print_header() {
+	printf("%-16s %9s %8s %8s %8s %8s %9s %8s %8s %6s %6s %8s %5s %4s\n",
+		"phase", "loops/s", "avg us", "max us", "mcp/lp", "tmc/lp", "spiB/lp", "lcd us", "lcdB/fr", "isr%", "awake%", "steps/s", "busy", "wdt");
+}
+
+static void phase_begin(const char* name) {
+	phase.name = name;
+	phase.start = now();
+	phase.counters = counters;
+	phase.iterations = 0;
+	phase.loop_max = 0;
+	phase.frames = 0;
+	phase.frame_bytes = 0;
+}
+
+static void phase_end() {
+	counters_t d = delta(counters, phase.counters);
+	double us = double(now() - phase.start) / CYCLES_PER_US;
+	double n = phase.iterations ? phase.iterations : 1;
+	printf("%-16s %9.0f %8.1f %8.1f %8.2f %8.2f %9.1f %8.1f %8.1f %6.2f %6.2f %8.0f %5u %4u\n",
+		phase.name,
+		phase.iterations * 1e6 / us,
+		us / n,
+		double(phase.loop_max) / CYCLES_PER_US,
+		d.spi_transactions[SPI_MCP] / n,
+		d.spi_transactions[SPI_TMC] / n,
+		(d.spi_bytes[SPI_MCP] + d.spi_bytes[SPI_TMC]) / n,
+		d.bucket[BUCKET_LCD] / CYCLES_PER_US / n,
+		phase.frames ? double(phase.frame_bytes) / phase.frames : 0.0,
+		100.0 * d.bucket[BUCKET_ISR] / (d.cycles ? d.cycles : 1),
+		100.0 * (d.cycles - d.bucket[BUCKET_IDLE]) / (d.cycles ? d.cycles : 1),
+		d.steps * 1e6 / us,
+		d.lcd_busy_violations,
+		d.wdt_expired);
+	if (verbose) {
+		for (uint8_t row = 0; row < 4; ++row)
+			printf("    |%s|\n", lcd_row(row));
+	}
+}
+
+/*** loop driver ***/
+
+static void run_once() {
+	uint64_t start = now();
+	uint32_t lcd_bytes = counters.lcd_bytes;
+	advance(BUCKET_CPU, LOOP_OVERHEAD);
+	loop();
+	uint64_t cycles = now() - start;
+	if (cycles > phase.loop_max)
+		phase.loop_max = cycles;
+	++phase.iterations;
+	// frame = loop iteration which sent the last changed cell to the display
+	if (counters.lcd_bytes != lcd_bytes && lcd.is_flushed()) {
+		++phase.frames;
+		phase.frame_bytes += lcd.get_frame_bytes();
+	}
+}
+
+static void run_for(uint32_t ms) {
+	uint64_t end = now() + uint64_t(ms) * CYCLES_PER_MS;
+	while (now() < end)
+		run_once();
+}
+
+//! @return true when condition was met before timeout
+static bool run_until(bool (*condition)(), uint32_t timeout_ms) {
+	uint64_t end = now() + uint64_t(timeout_ms) * CYCLES_PER_MS;
+	while (!condition()) {
+		if (now() >= end)
+			return false;
+		run_once();
+	}
+	return true;
+}
+
+/*** user input ***/
+
+// encoder quadrature states, bit0 = BTN_EN1, bit1 = BTN_EN2, resting at 3
+static const uint8_t encoder_up[4] = {1, 0, 2, 3};
+static const uint8_t encoder_down[4] = {2, 0, 1, 3};
+static uint8_t encoder_queue[256];	// uint8_t indexes wrap with it
+static uint8_t encoder_head = 0;
+static uint8_t encoder_tail = 0;
+
+static void encoder_step() {
+	uint8_t state = encoder_queue[encoder_tail++ % sizeof(encoder_queue)];
+	drive_pin(BTN_EN1, state & 1);
+	drive_pin(BTN_EN2, state & 2);
+}
+
+static void encoder_detent(uint64_t at, bool up) {
+	const uint8_t* sequence = up ? encoder_up : encoder_down;
+	for (uint8_t i = 0; i < 4; ++i) {
+		encoder_queue[encoder_head++ % sizeof(encoder_queue)] = sequence[i];
+		schedule(at + i * 2 * CYCLES_PER_MS, encoder_step);
+	}
+}
+
+static void button_down() {
+	mcp_drive(BTN_ENC, LOW);
+}
+
+static void button_up() {
+	mcp_drive(BTN_ENC, HIGH);
+}
+
+static void button_press(uint64_t at) {
+	schedule(at, button_down);
+	schedule(at + 100 * CYCLES_PER_MS, button_up);
+}
+
+static void cover_open() {
+	mcp_drive(COVER_OPEN_PIN, HIGH);
+}
+
+static void cover_close() {
+	mcp_drive(COVER_OPEN_PIN, LOW);
+}
+
+static bool led_on() {
+	return mcp_output(LED_RELE_PIN);
+}
+
+static bool led_off() {
+	return !mcp_output(LED_RELE_PIN);
+}
+
+static bool ramp_done() {
+	return !(TIMSK3 & _BV(OCIE3A));
+}
+
+/*** scenarios ***/
+
+//! menu idle, menu scrolling, curing and cover open latency
+static void scenario_loop() {
+	phase_begin("menu idle");
+	run_for(2000);
+	phase_end();
+
+	phase_begin("menu scroll");
+	uint64_t at = now();
+	for (uint8_t i = 0; i < 8; ++i)
+		encoder_detent(at + i * 150 * CYCLES_PER_MS, i < 4);
+	run_for(1400);
+	phase_end();
+
+	config.curing_machine_mode = 1;
+	phase_begin("curing");
+	button_press(now());
+	bool started = run_until(led_on, 5000);
+	run_for(1000);
+	phase_end();
+	if (!started) {
+		printf("curing did not start\n");
+		return;
+	}
+
+	const uint8_t trials = 10;
+	uint64_t latency_sum = 0;
+	uint64_t latency_max = 0;
+	uint8_t measured = 0;
+	phase_begin("cover cycling");
+	for (uint8_t i = 0; i < trials; ++i) {
+		if (!run_until(led_on, 5000))
+			break;
+		// open at a different phase of the loop every trial
+		uint64_t opened = now() + (200 + (i * 137) % 500) * CYCLES_PER_MS + i * 131;
+		schedule(opened, cover_open);
+		while (now() < opened)
+			run_once();
+		if (!run_until(led_off, 1000))
+			break;
+		uint64_t latency = mcp_output_changed(LED_RELE_PIN) - opened;
+		latency_sum += latency;
+		if (latency > latency_max)
+			latency_max = latency;
+		++measured;
+		run_for(300);
+		cover_close();
+	}
+	phase_end();
+	if (measured)
+		printf("cover open -> LED off: avg %.1f us, max %.1f us (%u/%u trials)\n",
+			double(latency_sum) / measured / CYCLES_PER_US,
+			double(latency_max) / CYCLES_PER_US,
+			measured, trials);
+	else
+		printf("cover open -> LED off: not measured\n");
+}
+
+//! scheduler task statistics over 10 s of menu idle with the fans check running
+static void scenario_scheduler() {
+	static const char* const names[Scheduler::TASK_COUNT] = {
+		"fans",
+		"fans PI",
+	#ifdef CW1S
+		"heater PID",
+	#endif
+		"MCP poll",
+		"config",
+		"switch test",
+		"beep",
+		"spinner",
+		"redraw",
+	};
+	memset(Scheduler::stats, 0, sizeof(Scheduler::stats));
+	phase_begin("scheduled idle");
+	run_for(10000);
+	phase_end();
+	for (uint8_t i = 0; i < Scheduler::TASK_COUNT; ++i) {
+		const Scheduler::task_stats_t& stats = Scheduler::stats[i];
+		printf("task %-12s runs %5u, late %u, max latency %u ms, max run %u us\n",
+			names[i], stats.runs, stats.late, stats.max_late, stats.max_us);
+	}
+}
+
+//! fast encoder spin in menu, alone and across a blocking beep: detents delivered as events and their queue wait
+static void scenario_events() {
+	const uint8_t detents = 40;
+	for (uint8_t blocking = 0; blocking < 2; ++blocking) {
+		memset(&Events::stats, 0, sizeof(Events::stats));
+		phase_begin(blocking ? "spin + beep" : "spin");
+		// 125 detents/s, one direction, more than the queue holds
+		uint64_t at = now();
+		for (uint8_t i = 0; i < detents; ++i)
+			encoder_detent(at + i * 8 * CYCLES_PER_MS, blocking);
+		if (blocking)
+			hw.beep();
+		run_for(detents * 8 + 500);
+		phase_end();
+		printf("%u detents: %u events, %u dropped, wait avg %.1f us, max %lu us\n",
+			detents, Events::stats.events, Events::stats.dropped,
+			Events::stats.events ? double(Events::stats.wait_us) / Events::stats.events : 0.0,
+			Events::stats.max_wait_us);
+	}
+
+	// safety: cover opened while the detents fill the queue, curing has to pause
+	if (States::active_state->is_paused())
+		States::active_state->pause_continue();
+	if (!run_until(led_on, 5000)) {
+		printf("spin + cover: curing not running, skipped\n");
+		return;
+	}
+	memset(&Events::stats, 0, sizeof(Events::stats));
+	phase_begin("spin + cover");
+	uint64_t at = now();
+	for (uint8_t i = 0; i < detents; ++i)
+		encoder_detent(at + i * 8 * CYCLES_PER_MS, true);
+	schedule(at + 200 * CYCLES_PER_MS, cover_open);
+	hw.beep();
+	run_for(3000);
+	phase_end();
+	printf("cover opened during spin + beep: %u dropped, LED %s, %s\n", Events::stats.dropped,
+		led_on() ? "ON" : "off", States::active_state->is_paused() ? "paused" : "NOT PAUSED");
+	cover_close();
+	run_for(1000);
+
+	// cover opened and closed again between two input reads
+	States::active_state->pause_continue();
+	if (!run_until(led_on, 5000)) {
+		printf("cover blip: curing not running, skipped\n");
+		return;
+	}
+	memset(&Events::stats, 0, sizeof(Events::stats));
+	at = now() + 10 * CYCLES_PER_MS;
+	schedule(at, cover_open);
+	schedule(at + 5 * CYCLES_PER_US, cover_close);
+	run_for(1000);
+	printf("cover blip 5 us: %u of 2 events\n", Events::stats.events);
+	States::active_state->pause_continue();
+	run_for(1000);
+}
+
+static void detents(uint8_t count, bool up, uint32_t interval_ms) {
+	for (uint8_t i = 0; i < count; ++i) {
+		encoder_detent(now(), up);
+		run_for(interval_ms);
+	}
+}
+
+//! LCD brightness 5 -> 100 % in Settings at different encoder speeds: detents and redraws needed
+static void scenario_accel() {
+	static const uint8_t intervals[] = {150, 60, 30, 15};
+	if (States::active_state != &States::menu) {
+		printf("accel: not in menu, skipped\n");
+		return;
+	}
+	detents(4, true, 150);	// Settings
+	button_press(now());
+	run_for(300);
+	detents(5, true, 150);	// LCD brightness
+	button_press(now());
+	run_for(300);
+	const uint8_t brightness = config.lcd_brightness;
+	for (uint8_t interval : intervals) {
+		config.lcd_brightness = MIN_LCD_BRIGHTNESS;
+		char name[32];
+		snprintf(name, sizeof(name), "detent %u ms", interval);
+		phase_begin(name);
+		uint64_t start = now();
+		uint8_t count = 0;
+		while (config.lcd_brightness < 100 && count < 200) {
+			detents(1, true, interval);
+			++count;
+		}
+		run_for(100);
+		uint32_t frames = phase.frames;
+		phase_end();
+		printf("%u -> %u %%: %u detents, %.2f s, %u LCD frames\n", MIN_LCD_BRIGHTNESS, config.lcd_brightness,
+			count, double(now() - start) / CYCLES_PER_MS / 1000, frames);
+	}
+	config.lcd_brightness = brightness;
+	button_press(now());	// back to Settings
+	run_for(300);
+	detents(6, false, 150);
+	button_press(now());	// back to home
+	run_for(300);
+}
+
+//! @return program memory reads of the loop passes which got a detent, mostly label rendering
+static uint32_t detents_reads(uint8_t count, bool up, uint32_t interval_ms) {
+	uint32_t reads = 0;
+	for (uint8_t i = 0; i < count; ++i) {
+		uint64_t end = now() + uint64_t(interval_ms) * CYCLES_PER_MS;
+		encoder_detent(now(), up);
+		while (now() < end) {
+			uint32_t events = Events::stats.events;
+			uint32_t reads_last = counters.pgm_reads;
+			run_once();
+			if (Events::stats.events != events)
+				reads += counters.pgm_reads - reads_last;
+		}
+	}
+	return reads;
+}
+
+//! Settings scrolled down and up: label rendering and display bytes per detent
+static void scenario_scroll() {
+	if (States::active_state != &States::menu) {
+		printf("scroll: not in menu, skipped\n");
+		return;
+	}
+	detents(4, true, 150);	// Settings
+	button_press(now());
+	run_for(300);
+	phase_begin("settings scroll");
+	uint32_t reads = detents_reads(6, true, 150);
+	reads += detents_reads(6, false, 150);
+	counters_t d = delta(counters, phase.counters);
+	phase_end();
+	printf("12 detents: %.1f pgm reads, %.1f LCD bytes per detent\n", reads / 12.0, d.lcd_bytes / 12.0);
+	button_press(now());	// back to home
+	run_for(300);
+}
+
+//! @return milliseconds from now to the last EEPROM write within ms
+static double run_eeprom(uint32_t ms) {
+	uint64_t start = now();
+	uint64_t end = start + uint64_t(ms) * CYCLES_PER_MS;
+	uint64_t written = start;
+	while (now() < end) {
+		uint32_t writes = counters.eeprom_writes;
+		run_once();
+		if (counters.eeprom_writes != writes)
+			written = now();
+	}
+	return double(written - start) / CYCLES_PER_MS;
+}
+
+//! Units in Settings > Temperatures toggled: EEPROM writes, busy waiting and the stored config
+static void scenario_config() {
+	if (States::active_state != &States::menu) {
+		printf("config: not in menu, skipped\n");
+		return;
+	}
+	detents(4, true, 150);	// Settings
+	button_press(now());
+	run_for(300);
+	detents(3, true, 150);	// Temperatures
+	button_press(now());
+	run_for(300);
+	detents(4, true, 150);	// Units
+	run_for(CONFIG_WRITE_DELAY + 1000);
+
+	static const struct {
+		const char* name;
+		uint8_t presses;
+	} toggles[] = {
+		{"units first", 1},		// stores whole config if EEPROM has no current one
+		{"units toggle", 1},
+		{"units toggle x2", 2},
+	};
+	for (auto& toggle : toggles) {
+		phase_begin(toggle.name);
+		for (uint8_t i = 0; i < toggle.presses; ++i) {
+			button_press(now());
+			run_for(300);
+		}
+		double ms = run_eeprom(CONFIG_WRITE_DELAY + 3000);
+		counters_t d = delta(counters, phase.counters);
+		phase_end();
+		printf("%s: %u EEPROM writes, last %.0f ms after the last press, %.1f us busy waiting\n", toggle.name,
+			d.eeprom_writes, ms ? ms + 300 : 0, double(d.bucket[BUCKET_EEPROM]) / CYCLES_PER_US);
+	}
+
+	eeprom_v4_t saved = config;
+	read_config();
+	printf("EEPROM %s config\n", memcmp(&saved, &config, sizeof(config)) ? "differs from" : "matches");
+	config = saved;
+
+	detents(4, false, 150);	// back to Settings
+	button_press(now());
+	run_for(300);
+	detents(3, false, 150);	// back to home
+	button_press(now());
+	run_for(300);
+}
+
+//! cycles spent in lcd.flush() per byte sent to the display
+static void scenario_lcd() {
+	const uint8_t frames = 10;
+	uint64_t cycles = 0;
+	counters_t start = counters;
+	for (uint8_t i = 0; i < frames; ++i) {
+		for (uint8_t row = 0; row < DISPLAY_LINES; ++row) {
+			lcd.setCursor(0, row);
+			for (uint8_t col = 0; col < DISPLAY_CHARS; ++col)
+				lcd.write('A' + (i + row + col) % 26);
+		}
+		do {
+			wait_until(BUCKET_IDLE, now() + LCD_SETTLE_US * CYCLES_PER_US);
+			uint64_t at = now();
+			lcd.flush();
+			cycles += now() - at;
+		} while (!lcd.is_flushed());
+	}
+	counters_t d = delta(counters, start);
+	printf("lcd: %u bytes in %u frames, %.0f cycles per byte, %.0f cycles per character\n",
+		d.lcd_bytes, frames, double(cycles) / d.lcd_bytes, double(cycles) / (frames * DISPLAY_CHARS * DISPLAY_LINES));
+}
+
+//! stepper CPU load for every speed setting, slow (curing) and fast (washing) mode
+static void scenario_stepper() {
+	static const char* const names[2][10] = {
+		{"slow 1", "slow 2", "slow 3", "slow 4", "slow 5", "slow 6", "slow 7", "slow 8", "slow 9", "slow 10"},
+		{"fast 1", "fast 2", "fast 3", "fast 4", "fast 5", "fast 6", "fast 7", "fast 8", "fast 9", "fast 10"},
+	};
+	uint64_t ramp[10];
+	for (uint8_t fast = 0; fast < 2; ++fast) {
+		for (uint8_t speed = 1; speed <= 10; ++speed) {
+			hw.speed_configuration(speed, fast);
+			hw.run_motor();
+			// fast mode accelerates from FAST_SPEED_START
+			if (fast) {
+				uint64_t start = now();
+				run_until(ramp_done, 10000);
+				ramp[speed - 1] = now() - start;
+			}
+			run_for(200);
+			phase_begin(names[fast][speed - 1]);
+			run_for(1000);
+			phase_end();
+			hw.stop_motor();
+		}
+	}
+	printf("fast ramp ms:");
+	for (uint8_t speed = 1; speed <= 10; ++speed)
+		printf(" %.0f", double(ramp[speed - 1]) / CYCLES_PER_MS);
+	printf("\n");
+}
+
+//! TMC2130 SPI bytes per speed change, as done by the states and the rotation test
+static void scenario_tmc() {
+	uint32_t bytes = 0;
+	uint32_t bytes_max = 0;
+	uint16_t changes = 0;
+	auto change = [&](uint8_t speed, bool fast, bool gear_shifting) {
+		uint32_t start = counters.spi_bytes[SPI_TMC];
+		hw.speed_configuration(speed, fast, gear_shifting);
+		uint32_t d = counters.spi_bytes[SPI_TMC] - start;
+		bytes += d;
+		if (d > bytes_max)
+			bytes_max = d;
+		++changes;
+	};
+	phase_begin("speed changes");
+	// pause / continue of a washing and a curing state
+	for (uint8_t i = 0; i < 3; ++i) {
+		change(10, true, false);
+		hw.run_motor();
+		run_until(ramp_done, 10000);
+		run_for(100);
+		hw.stop_motor();
+		change(5, false, false);
+		hw.run_motor();
+		run_for(100);
+		hw.stop_motor();
+	}
+	// rotation test gear shifting
+	hw.run_motor();
+	for (uint8_t fast = 2; fast-- > 0;) {
+		for (uint8_t speed = 10; speed > 0; --speed) {
+			change(speed, fast, true);
+			run_for(50);
+		}
+	}
+	hw.stop_motor();
+	phase_end();
+	printf("speed change: avg %.1f, max %u TMC SPI bytes (%u changes)\n",
+		double(bytes) / changes, bytes_max, changes);
+}
+
+//! thermistor_celsius() against interpolate_i16_ylin_P() for every ADC value
+static void scenario_thermistor() {
+	static const struct {
+		const char* name;
+		const int16_t* raw;
+		thermistor_t table;
+	} thermistors[] = {
+		{"chamber", chamber_temp_table_raw, thermistor_t(chamber_temp_table_raw)},
+		{"uvled", uvled_temp_table_raw, thermistor_t(uvled_temp_table_raw)},
+	};
+	for (const auto& thermistor : thermistors) {
+		uint16_t mismatches = 0;
+		int16_t worst = 0;
+		for (int16_t adc = 0; adc < THERM_ADC_RANGE; ++adc) {
+			int16_t expected = interpolate_i16_ylin_P(adc, THERM_TABLE_SIZE, thermistor.raw, THERM_TEMP_MAX, -THERM_TEMP_STEP);
+			int16_t diff = abs(thermistor_celsius(&thermistor.table, adc) - expected);
+			if (diff) {
+				++mismatches;
+				if (diff > worst)
+					worst = diff;
+			}
+		}
+		bool fail = worst > 1;
+		failed |= fail;
+		printf("thermistor %s: %u/%u ADC values differ, max %d.%d C%s\n",
+			thermistor.name, mismatches, THERM_ADC_RANGE, worst / 10, worst % 10, fail ? " FAIL" : "");
+	}
+}
+
+static bool chamber_at_target() {
+	#ifdef CW1S
+		return hw.chamber_temp_celsius >= config.target_temp * 10 - WARMUP_TEMP_TOLERANCE;
+	#else
+		return hw.chamber_temp_celsius >= config.target_temp * 10;
+	#endif
+}
+
+//! fan2 tacho reading after duty changes: delay behind the simulated fan and steady reading
+static void scenario_tacho() {
+	static const uint8_t duties[] = {100, 50, 30, 100};
+	const uint16_t samples = 500;
+	const uint32_t sample_ms = 10;
+	static uint16_t readings[samples];
+	static float truths[samples];
+	for (uint8_t duty : duties) {
+		hw.set_fan2_duty(duty);
+		for (uint16_t i = 0; i < samples; ++i) {
+			run_for(sample_ms);
+			readings[i] = hw.fan_rpm[1];
+			// firmware counts tacho pulses per minute, simulated fan has FAN_PULSES_PER_REV 2
+			truths[i] = 2.0f * fan_rpm(1);
+		}
+		float final = truths[samples - 1];
+		uint16_t reading_settled = 0;
+		uint16_t fan_settled = 0;
+		uint16_t low = UINT16_MAX;
+		uint16_t high = 0;
+		for (uint16_t i = 0; i < samples; ++i) {
+			if (fabsf(readings[i] - final) > 0.03f * final)
+				reading_settled = i + 1;
+			if (fabsf(truths[i] - final) > 0.03f * final)
+				fan_settled = i + 1;
+			if (i >= samples / 2) {
+				if (readings[i] < low)
+					low = readings[i];
+				if (readings[i] > high)
+					high = readings[i];
+			}
+		}
+		printf("tacho duty %3u%%: fan %5.0f, reading within 3%% %4d ms after fan, steady reading %u..%u\n",
+			duty, final, (reading_settled - fan_settled) * (int)sample_ms, low, high);
+	}
+	hw.set_fan2_duty(config.fans_menu_speed[1]);
+}
+
+static bool calibration_done() {
+	return States::active_state != &States::fans_calibration;
+}
+
+static bool fan_error() {
+	return States::active_state == &States::error;
+}
+
+//! fan2 speed at 60 % with a new and a worn fan, open loop and with RPM control, then a failing fan
+static void scenario_fanloop() {
+	phase_begin("fans calibration");
+	States::change(&States::fans_calibration);
+	run_until(calibration_done, 60000);
+	phase_end();
+	bool learned = States::active_state == &States::confirm;
+	States::change(&States::menu);
+	if (!learned) {
+		printf("fans calibration failed\n");
+		return;
+	}
+	printf("fan2 curve:");
+	for (uint8_t i = 0; i < FAN_CURVE_POINTS; ++i)
+		printf(" %u", config.fans_curve[1][i]);
+	printf("\n");
+
+	const uint8_t duty = 60;
+	const uint16_t target = (uint32_t)FAN_RPM_NOMINAL * duty / 100;
+	static const float healths[] = {1.0f, 0.85f, 0.7f};
+	for (float health : healths) {
+		fan_health[1] = health;
+		uint16_t reading[2];
+		for (uint8_t control = 0; control < 2; ++control) {
+			config.fans_rpm_control = control;
+			hw.set_fan2_duty(duty);
+			run_for(10000);
+			reading[control] = hw.fan_rpm[1];
+		}
+		printf("fan2 %3.0f %% health at %u %%: open loop %u, RPM control %u (target %u)\n",
+			health * 100, duty, reading[0], reading[1], target);
+	}
+
+	fan_health[1] = 0.5f;
+	hw.set_fan2_duty(100);
+	phase_begin("failing fan");
+	uint64_t start = now();
+	bool detected = run_until(fan_error, 60000);
+	phase_end();
+	if (detected)
+		printf("fan2 at 50 %% health: error after %.1f s\n", double(now() - start) / CYCLES_PER_MS / 1000);
+	else
+		printf("fan2 at 50 %% health: not detected\n");
+	States::change(&States::menu);
+
+	// a failed calibration keeps the learned curve
+	fan_health[1] = 0.0f;
+	uint16_t learned_rpm = config.fans_curve[1][FAN_CURVE_POINTS - 1];
+	States::change(&States::fans_calibration);
+	run_until(calibration_done, 60000);
+	printf("fan2 stalled: calibration %s, curve %s\n",
+		States::active_state == &States::error ? "failed" : "passed",
+		config.fans_curve[1][FAN_CURVE_POINTS - 1] == learned_rpm ? "kept" : "changed");
+	States::change(&States::menu);
+	fan_health[1] = 1.0f;
+	config.fans_rpm_control = 0;
+	hw.set_fan2_duty(config.fans_menu_speed[1]);
+}
+
+struct room_t {
+	const char* warmup;
+	const char* holding;
+	float ambient;
+};
+
+//! warm-up from ambient to config.target_temp and 5 minutes holding it, as States::Warmup and drying do
+static void warmup_hold(const room_t& room) {
+	const float target = config.target_temp;
+	thermal.ambient = thermal.chamber = thermal.uvled = room.ambient;
+	run_for(2000);	// let the averaged temperatures follow
+	hw.set_fans(config.fans_drying_speed);
+	hw.run_heater();
+
+	phase_begin(room.warmup);
+	uint64_t start = now();
+	bool reached = run_until(chamber_at_target, MAX_WARMUP_RUNTIME * 60000UL);
+	uint64_t warmup = now() - start;
+	phase_end();
+
+	// last 2 minutes are steady state
+	float peak = thermal.chamber;
+	float steady_min = 1000;
+	float steady_max = -1000;
+	phase_begin(room.holding);
+	uint64_t end = now() + 5 * 60000ULL * CYCLES_PER_MS;
+	uint64_t steady = end - 2 * 60000ULL * CYCLES_PER_MS;
+	while (now() < end) {
+		run_once();
+		if (thermal.chamber > peak)
+			peak = thermal.chamber;
+		if (now() >= steady) {
+			if (thermal.chamber < steady_min)
+				steady_min = thermal.chamber;
+			if (thermal.chamber > steady_max)
+				steady_max = thermal.chamber;
+		}
+	}
+	phase_end();
+	hw.stop_heater();
+
+	// warm-up has to finish in every room, the CW1S PID has to hold the target within 0.2 C too
+	bool fail = !reached;
+	#ifdef CW1S
+		fail |= steady_min < target - 0.2f || steady_max > target + 0.2f;
+	#endif
+	failed |= fail;
+	if (reached)
+		printf("warmup %.0f -> %.0f C: %.1f s,", room.ambient, target, double(warmup) / CYCLES_PER_MS / 1000);
+	else
+		printf("warmup %.0f -> %.0f C: timeout after %u min,", room.ambient, target, MAX_WARMUP_RUNTIME);
+	printf(" overshoot %.2f C, steady %.2f..%.2f C%s\n", peak - target, steady_min - target, steady_max - target, fail ? " FAIL" : "");
+	thermal.ambient = thermal.chamber = thermal.uvled = 22.0f;
+}
+
+static void scenario_warmup() {
+	static const room_t rooms[] = {
+		{"warmup 22C", "holding 22C", 22.0f},
+		{"warmup 26C", "holding 26C", 26.0f},
+	};
+	for (const room_t& room : rooms)
+		warmup_hold(room);
+}
+
+#ifdef CW1S
+//! heater output at fixed duties: achieved duty, switching rate and longest on/off window
+static void scenario_heater() {
+	static const uint16_t duties[] = {1, 10, 100, 333, 500, 900};
+	hw.run_heater();
+	for (uint16_t duty : duties) {
+		hw.set_heater_open_loop(duty);
+		run_for(2000);
+		uint64_t start = now();
+		uint64_t end = start + 20000ULL * CYCLES_PER_MS;
+		uint64_t on_cycles = 0;
+		uint64_t on_max = 0;
+		uint64_t off_max = 0;
+		uint32_t switches = 0;
+		bool on = mcp_output(FAN_HEAT_PIN);
+		uint64_t changed = start;
+		while (now() < end) {
+			run_once();
+			bool state = mcp_output(FAN_HEAT_PIN);
+			if (state != on) {
+				// the main loop may sleep after the change, take the time of the pin write
+				uint64_t at = mcp_output_changed(FAN_HEAT_PIN);
+				uint64_t window = at - changed;
+				if (on) {
+					on_cycles += window;
+					if (window > on_max)
+						on_max = window;
+				} else if (window > off_max) {
+					off_max = window;
+				}
+				changed = at;
+				on = state;
+				++switches;
+			}
+		}
+		if (on)
+			on_cycles += end - changed;
+		printf("heater duty %4u: achieved %6.1f, %5.1f switches/s, longest on %7.1f ms, off %7.1f ms\n",
+			duty, 1000.0 * on_cycles / (end - start), switches / 20.0,
+			double(on_max) / CYCLES_PER_MS, double(off_max) / CYCLES_PER_MS);
+	}
+	hw.stop_heater();
+}
+
+static bool autotune_done() {
+	return States::active_state != &States::heater_autotune;
+}
+
+//! relay autotune in a 26 C room, then warm-up with the tuned gains
+static void scenario_autotune() {
+	const room_t room = {"warmup tuned", "holding tuned", 26.0f};
+	uint32_t gains[3] = {config.heater_pid_kp, config.heater_pid_ki, config.heater_pid_kd};
+	thermal.ambient = thermal.chamber = thermal.uvled = room.ambient;
+	run_for(2000);
+
+	phase_begin("autotune");
+	uint64_t start = now();
+	States::change(&States::heater_autotune);
+	run_until(autotune_done, HEATER_AUTOTUNE_TIME * 60000UL);
+	uint64_t tuning = now() - start;
+	phase_end();
+	bool tuned = States::active_state == &States::confirm;
+	States::change(&States::menu);
+	if (!tuned) {
+		printf("autotune failed after %.1f s\n", double(tuning) / CYCLES_PER_MS / 1000);
+		return;
+	}
+	printf("autotune %.0f C: %.1f s, kp %lu ki %lu kd %lu (defaults %lu %lu %lu)\n",
+		room.ambient, double(tuning) / CYCLES_PER_MS / 1000,
+		(unsigned long)config.heater_pid_kp, (unsigned long)config.heater_pid_ki, (unsigned long)config.heater_pid_kd,
+		(unsigned long)gains[0], (unsigned long)gains[1], (unsigned long)gains[2]);
+	warmup_hold(room);
+	config.heater_pid_kp = gains[0];
+	config.heater_pid_ki = gains[1];
+	config.heater_pid_kd = gains[2];
+}
+#endif
+
+struct scenario_t {
+	const char* name;
+	void (*run)();
+};
+
+static const scenario_t scenarios[] = {
+	{"accel", scenario_accel},	// before loop, which leaves curing running
+	{"scroll", scenario_scroll},
+	{"config", scenario_config},
+	{"loop", scenario_loop},
+	{"lcd", scenario_lcd},
+	{"scheduler", scenario_scheduler},
+	{"events", scenario_events},
+	{"stepper", scenario_stepper},
+	{"tmc", scenario_tmc},
+	{"thermistor", scenario_thermistor},
+	{"tacho", scenario_tacho},
+	{"fanloop", scenario_fanloop},
+	{"warmup", scenario_warmup},
+	#ifdef CW1S
+		{"heater", scenario_heater},
+		{"autotune", scenario_autotune},
+	#endif
+};
+
+int main(int argc, char* argv[]) {
+	int first = 1;
+	if (argc > 1 && !strcmp(argv[1], "-v")) {
+		verbose = true;
+		++first;
+	}
+
+	init();
+	uint64_t boot = now();
+	setup();
+	printf("%s: setup %.1f ms\n",
+		#ifdef CW1S
+			"CW1S",
+		#else
+			"CW1",
+		#endif
+		double(now() - boot) / CYCLES_PER_MS);
+
+	print_header();
+	for (const scenario_t& scenario : scenarios) {
+		bool selected = first == argc;
+		for (int i = first; i < argc; ++i) {
+			if (!strcmp(argv[i], scenario.name))
+				selected = true;
+		}
+		if (selected)
+			scenario.run();
+	}
+	return failed;
+}
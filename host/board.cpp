@@ -0,0 +1,506 @@
+// Simulated CW1/CW1S board around the MCU: HD44780 LCD, MCP23S17 expander,
+// TMC2130 stepper driver, fans with tacho outputs and a lumped thermal model
+// read through the thermistor analog switch.
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <Arduino.h>
+#include "sim.h"
+#include "defines.h"
+
+#define MCP_SS_PIN			8		// Hardware::outputchip(0, 8)
+#define MCP_INTA_WIRE		23		// INTA is wired to A5 on the simulated board, see MCP_INTA_PIN
+
+#define LCD_INSTR_US		37
+#define LCD_DATA_US			41
+#define LCD_CLEAR_US		1520
+
+#define FAN_MAX_RPM			3000
+#define FAN_PULSES_PER_REV	2
+#define FAN_TAU_S			0.5f
+
+#define PHYSICS_TICK_MS		10
+#define HEATER_POWER		60.0f	// W
+#define UVLED_POWER			30.0f	// W at 100 %
+#define CHAMBER_CAPACITY	1500.0f	// J/K
+#define CHAMBER_LOSS		1.5f	// W/K to ambient, still air
+#define UVLED_CAPACITY		150.0f	// J/K
+#define UVLED_COUPLING		1.0f	// W/K to chamber
+#define THERM_TAU_US		470.0f	// 4k7 pull-up and 100n filter
+#define THERM_CHANNEL		1		// THERM_READ_PIN is A4/ADC1
+
+#define NEVER UINT64_MAX
+
+namespace Sim {
+
+	thermal_t thermal = {22.0f, 22.0f, 22.0f};
+	float fan_health[3] = {1.0f, 1.0f, 1.0f};
+
+	// thermistor curves, same as the firmware tables (125 °C down by 5 °C)
+	static const int16_t chamber_curve[34] = {
+		25, 29, 34, 40, 46, 54, 64, 75, 88, 105, 124, 146, 173, 204, 241, 282, 330, 382, 439, 500,
+		563, 625, 687, 744, 796, 842, 882, 915, 941, 963, 979, 992, 1001, 1008
+	};
+	static const int16_t uvled_curve[34] = {
+		73, 83, 95, 109, 125, 144, 165, 189, 217, 248, 284, 323, 366, 412, 462, 514, 567, 620, 673, 723,
+		770, 813, 851, 885, 913, 937, 957, 973, 986, 995, 1003, 1009, 1013, 1016
+	};
+
+	/*** HD44780 ***/
+
+	struct lcd_t {
+		bool four_bit;
+		bool low_nibble;
+		uint8_t high;
+		bool cgram;
+		bool decrement;
+		uint8_t address;
+		uint8_t ddram[0x80];
+		uint8_t cgram_data[0x40];
+		uint64_t busy_until;
+	};
+	static lcd_t lcd_chip;
+
+	static uint8_t lcd_next(uint8_t address, bool decrement) {
+		if (decrement)
+			return address == 0x00 ? 0x67 : address == 0x40 ? 0x27 : address - 1;
+		return address == 0x27 ? 0x40 : address == 0x67 ? 0x00 : address + 1;
+	}
+
+	static void lcd_execute(bool rs, uint8_t value) {
+		lcd_t& l = lcd_chip;
+		if (now() < l.busy_until)
+			++counters.lcd_busy_violations;
+		++counters.lcd_bytes;
+		uint32_t busy_us = LCD_INSTR_US;
+		if (rs) {
+			if (l.cgram) {
+				l.cgram_data[l.address & 0x3F] = value;
+				l.address = (l.address + (l.decrement ? -1 : 1)) & 0x3F;
+			} else {
+				l.ddram[l.address & 0x7F] = value;
+				l.address = lcd_next(l.address, l.decrement);
+			}
+			busy_us = LCD_DATA_US;
+		} else if (value & 0x80) {
+			l.cgram = false;
+			l.address = value & 0x7F;
+		} else if (value & 0x40) {
+			l.cgram = true;
+			l.address = value & 0x3F;
+		} else if (value & 0x20) {
+			l.four_bit = !(value & 0x10);
+		} else if (value & 0x10) {
+			if (!(value & 0x08))
+				l.address = lcd_next(l.address, !(value & 0x04));
+		} else if (value & 0x04) {
+			l.decrement = !(value & 0x02);
+		} else if (value & 0x02) {
+			l.cgram = false;
+			l.address = 0;
+			busy_us = LCD_CLEAR_US;
+		} else if (value & 0x01) {
+			memset(l.ddram, ' ', sizeof(l.ddram));
+			l.cgram = false;
+			l.address = 0;
+			l.decrement = false;
+			busy_us = LCD_CLEAR_US;
+		}
+		l.busy_until = now() + busy_us * CYCLES_PER_US;
+	}
+
+	static void lcd_latch() {
+		lcd_t& l = lcd_chip;
+		uint8_t nibble = (pin_level(LCD_PINS_D4) ? 0x1 : 0) | (pin_level(LCD_PINS_D5) ? 0x2 : 0)
+			| (pin_level(LCD_PINS_D6) ? 0x4 : 0) | (pin_level(LCD_PINS_D7) ? 0x8 : 0);
+		bool rs = pin_level(LCD_PINS_RS);
+		if (!l.four_bit) {
+			lcd_execute(rs, nibble << 4);
+		} else if (!l.low_nibble) {
+			l.high = nibble;
+			l.low_nibble = true;
+		} else {
+			l.low_nibble = false;
+			lcd_execute(rs, (l.high << 4) | nibble);
+		}
+	}
+
+	const char* lcd_row(uint8_t row) {
+		static const uint8_t offsets[4] = {0x00, 0x40, 0x14, 0x54};
+		static char text[DISPLAY_CHARS + 1];
+		for (uint8_t i = 0; i < DISPLAY_CHARS; ++i) {
+			uint8_t c = lcd_chip.ddram[offsets[row & 3] + i];
+			text[i] = c < 8 ? '#' : (c >= ' ' && c < 0x7F ? c : '?');
+		}
+		text[DISPLAY_CHARS] = 0;
+		return text;
+	}
+
+	/*** MCP23S17 ***/
+
+	#define MCP_BIT(pin)	(1 << ((pin) - 1))
+
+	struct mcp_t {
+		uint8_t reg[0x16];
+		bool selected;
+		uint8_t index;
+		uint8_t opcode;
+		uint8_t pointer;
+		uint16_t driven;
+		uint16_t input;
+		uint16_t outputs;
+		uint64_t changed_at[16];
+		uint16_t last_gpio;
+	};
+	static mcp_t mcp = {
+		{0xFF, 0xFF},					// IODIRA/B all inputs after reset
+		false, 0, 0, 0,
+		MCP_BIT(COVER_OPEN_PIN), 0,		// cover closed, tank out, button released
+		0, {0}, 0,
+	};
+
+	static uint16_t mcp_word(uint8_t reg) {
+		return mcp.reg[reg] | (mcp.reg[reg + 1] << 8);
+	}
+
+	static uint16_t mcp_gpio() {
+		uint16_t iodir = mcp_word(0x00);
+		uint16_t pins = (mcp.driven & mcp.input) | (~mcp.driven & mcp_word(0x0C));
+		return (iodir & (pins ^ mcp_word(0x02))) | (~iodir & mcp_word(0x14));
+	}
+
+	static void fans_update();
+	static void analog_switch();
+
+	// interrupt on change: INTF/INTCAP latch the first change, reading GPIO or
+	// INTCAP of the port clears it, INTA (port A, no mirroring) is active low
+	static void mcp_interrupts() {
+		uint16_t gpio = mcp_gpio();
+		uint16_t enabled = mcp_word(0x04);
+		uint16_t intcon = mcp_word(0x08);
+		uint16_t cause = enabled & ((intcon & (gpio ^ mcp_word(0x06))) | (~intcon & (gpio ^ mcp.last_gpio)));
+		mcp.last_gpio = gpio;
+		for (uint8_t port = 0; port < 2; ++port) {
+			uint8_t port_cause = cause >> (8 * port);
+			if (port_cause && !mcp.reg[0x0E + port]) {
+				mcp.reg[0x0E + port] = port_cause;
+				mcp.reg[0x10 + port] = gpio >> (8 * port);
+			}
+		}
+		drive_pin(MCP_INTA_WIRE, !mcp.reg[0x0E]);
+	}
+
+	static void mcp_interrupt_clear(uint8_t port) {
+		mcp.reg[0x0E + port] = 0;
+		// compare against DEFVAL asserts again while the condition lasts
+		uint16_t gpio = mcp_gpio();
+		uint16_t cause = mcp_word(0x04) & mcp_word(0x08) & (gpio ^ mcp_word(0x06));
+		uint8_t port_cause = cause >> (8 * port);
+		if (port_cause) {
+			mcp.reg[0x0E + port] = port_cause;
+			mcp.reg[0x10 + port] = gpio >> (8 * port);
+		}
+		drive_pin(MCP_INTA_WIRE, !mcp.reg[0x0E]);
+	}
+
+	static void mcp_outputs() {
+		uint16_t outputs = ~mcp_word(0x00) & mcp_word(0x14);
+		uint16_t changed = outputs ^ mcp.outputs;
+		if (!changed)
+			return;
+		mcp.outputs = outputs;
+		for (uint8_t i = 0; i < 16; ++i) {
+			if (changed & (1 << i))
+				mcp.changed_at[i] = now();
+		}
+		if (changed & MCP_BIT(ANALOG_SWITCH_A))
+			analog_switch();
+		fans_update();
+	}
+
+	static uint8_t mcp_exchange(uint8_t data) {
+		uint8_t result = 0;
+		if (mcp.index == 0) {
+			mcp.opcode = data;
+		} else if (mcp.index == 1) {
+			mcp.pointer = data;
+		} else {
+			uint8_t reg = mcp.pointer;
+			if (mcp.opcode & 1) {
+				if (reg == 0x12 || reg == 0x13)
+					result = mcp_gpio() >> (8 * (reg - 0x12));
+				else
+					result = mcp.reg[reg];
+				if (reg >= 0x10 && reg <= 0x13)
+					mcp_interrupt_clear(reg & 1);
+			} else {
+				if (reg == 0x12 || reg == 0x13)
+					reg += 2;	// GPIO writes go to the output latch
+				if (reg == 0x0A || reg == 0x0B)
+					mcp.reg[0x0A] = mcp.reg[0x0B] = data;
+				else if (reg != 0x0E && reg != 0x0F && reg != 0x10 && reg != 0x11)
+					mcp.reg[reg] = data;
+				mcp_outputs();
+				mcp_interrupts();
+			}
+			mcp.pointer = mcp.pointer == 0x15 ? 0 : mcp.pointer + 1;
+		}
+		++mcp.index;
+		return result;
+	}
+
+	void mcp_drive(uint8_t pin, bool level) {
+		mcp.driven |= MCP_BIT(pin);
+		mcp.input = level ? mcp.input | MCP_BIT(pin) : mcp.input & ~MCP_BIT(pin);
+		mcp_interrupts();
+	}
+
+	bool mcp_output(uint8_t pin) {
+		return mcp.outputs & MCP_BIT(pin);
+	}
+
+	uint64_t mcp_output_changed(uint8_t pin) {
+		return mcp.changed_at[pin - 1];
+	}
+
+	/*** TMC2130 ***/
+
+	struct tmc_t {
+		uint32_t reg[0x80];
+		bool selected;
+		uint8_t index;
+		uint8_t address;
+		uint32_t data;
+		uint32_t read_latch;
+	};
+	static tmc_t tmc;
+
+	static uint8_t tmc_exchange(uint8_t data) {
+		uint8_t result = 0;
+		if (tmc.index == 0) {
+			tmc.address = data;
+			tmc.data = 0;
+		} else if (tmc.index <= 4) {
+			result = tmc.read_latch >> (8 * (4 - tmc.index));
+			tmc.data = (tmc.data << 8) | data;
+		}
+		++tmc.index;
+		return result;
+	}
+
+	static void tmc_end() {
+		if (tmc.index < 5)
+			return;
+		if (tmc.address & 0x80)
+			tmc.reg[tmc.address & 0x7F] = tmc.data;
+		else
+			tmc.read_latch = tmc.reg[tmc.address & 0x7F];
+	}
+
+	uint32_t tmc_register(uint8_t address) {
+		return tmc.reg[address & 0x7F];
+	}
+
+	static void step_edge(bool rising) {
+		bool dedge = tmc.reg[0x6C] & (1UL << 29);
+		if ((rising || dedge) && !mcp_output(EN_PIN))
+			++counters.steps;
+	}
+
+	/*** SPI bus ***/
+
+	static void spi_select(spi_device_t device, bool selected) {
+		if (device == SPI_MCP) {
+			mcp.selected = selected;
+			mcp.index = 0;
+		} else {
+			if (!selected)
+				tmc_end();
+			tmc.selected = selected;
+			tmc.index = 0;
+		}
+		if (selected)
+			++counters.spi_transactions[device];
+	}
+
+	uint8_t spi_exchange(uint8_t data) {
+		uint8_t result = 0xFF;
+		if (tmc.selected) {
+			++counters.spi_bytes[SPI_TMC];
+			result = tmc_exchange(data);
+		}
+		if (mcp.selected) {
+			++counters.spi_bytes[SPI_MCP];
+			result = mcp_exchange(data);
+		}
+		return result;
+	}
+
+	/*** fans ***/
+
+	struct fan_t {
+		float rpm;
+		uint64_t next_edge;
+		uint8_t interrupt;
+	};
+	static fan_t fans[3] = {
+		{0, NEVER, INT2},	// FAN1_TACHO_PIN 0
+		{0, NEVER, INT1},	// FAN2_TACHO_PIN 2
+		{0, NEVER, INT3},	// FAN_HEAT_TACHO_PIN 1
+	};
+	static float fan_targets[3];
+
+	static void fans_update() {
+		static const uint8_t pwm_pins[2] = {FAN1_PWM_PIN, FAN2_PWM_PIN};
+		static const uint8_t enable_pins[2] = {FAN1_PIN, FAN2_PIN};
+		for (uint8_t i = 0; i < 2; ++i) {
+			// PWM is inverted by the fan driver
+			fan_targets[i] = mcp_output(enable_pins[i]) ? FAN_MAX_RPM * (255 - pwm_value(pwm_pins[i])) / 255.0f : 0;
+		}
+		#ifndef CW1S
+			fan_targets[2] = mcp_output(FAN_HEAT_PIN) ? FAN_MAX_RPM : 0;
+		#endif
+	}
+
+	static uint64_t fan_period(const fan_t& fan) {
+		return 60.0f * 1000000 * CYCLES_PER_US / (fan.rpm * FAN_PULSES_PER_REV);
+	}
+
+	uint16_t fan_rpm(uint8_t fan) {
+		return fans[fan].rpm;
+	}
+
+	/*** thermal model and thermistor inputs ***/
+
+	static uint64_t physics_at = NEVER;
+	static float node_start;
+	static uint64_t node_switched;
+	static uint32_t noise = 12345;
+
+	static float thermistor_raw(const int16_t* curve, float temp) {
+		float f = (125.0f - temp) / 5.0f;
+		if (f <= 0)
+			return curve[0];
+		if (f >= 33)
+			return curve[33];
+		uint8_t i = f;
+		return curve[i] + (curve[i + 1] - curve[i]) * (f - i);
+	}
+
+	static float thermistor_target() {
+		if (mcp_output(ANALOG_SWITCH_A))
+			return thermistor_raw(uvled_curve, thermal.uvled);
+		return thermistor_raw(chamber_curve, thermal.chamber);
+	}
+
+	static float thermistor_node() {
+		float target = thermistor_target();
+		float dt_us = (now() - node_switched) / (float)CYCLES_PER_US;
+		return target + (node_start - target) * expf(-dt_us / THERM_TAU_US);
+	}
+
+	static void analog_switch() {
+		// the filter capacitor still holds the other sensor's voltage
+		node_start = thermistor_node();
+		node_switched = now();
+	}
+
+	uint16_t adc_sample(uint8_t channel) {
+		if (channel != THERM_CHANNEL)
+			return 0;
+		noise = noise * 1103515245 + 12345;
+		int16_t value = lroundf(thermistor_node()) + (int8_t)((noise >> 16) % 3) - 1;
+		return constrain(value, 0, 1023);
+	}
+
+	static void physics_step() {
+		const float dt = PHYSICS_TICK_MS / 1000.0f;
+		for (uint8_t i = 0; i < 3; ++i) {
+			fan_t& fan = fans[i];
+			fan.rpm += (fan_targets[i] * fan_health[i] - fan.rpm) * dt / FAN_TAU_S;
+			if (fan.rpm < 60) {
+				fan.next_edge = NEVER;
+			} else if (fan.next_edge == NEVER) {
+				fan.next_edge = now() + fan_period(fan);
+			}
+		}
+
+		float airflow = (fans[0].rpm + fans[1].rpm) / (2.0f * FAN_MAX_RPM);
+		bool heater = mcp_output(FAN_HEAT_PIN);
+		float led = mcp_output(LED_RELE_PIN) ? UVLED_POWER * pwm_value(LED_PWM_PIN) / 255.0f : 0;
+		float coupling = UVLED_COUPLING * (1.0f + airflow) * (thermal.uvled - thermal.chamber);
+		float loss = CHAMBER_LOSS * (1.0f + 2.0f * airflow) * (thermal.chamber - thermal.ambient);
+		thermal.chamber += ((heater ? HEATER_POWER : 0) + coupling - loss) * dt / CHAMBER_CAPACITY;
+		thermal.uvled += (led - coupling) * dt / UVLED_CAPACITY;
+	}
+
+	/*** board glue ***/
+
+	bucket_t board_pin_bucket(uint8_t pin) {
+		switch (pin) {
+			case LCD_PINS_RS:
+			case LCD_PINS_ENABLE:
+			case LCD_PINS_D4:
+			case LCD_PINS_D5:
+			case LCD_PINS_D6:
+			case LCD_PINS_D7:
+			case LCD_PWM_PIN:
+				return BUCKET_LCD;
+			case MCP_SS_PIN:
+			case CS_PIN:
+				return BUCKET_SPI;
+		}
+		return BUCKET_CPU;
+	}
+
+	static bool pin_in(uint8_t pin, uint8_t port, uint8_t changed) {
+		return pin_port(pin) == port && (pin_mask(pin) & changed);
+	}
+
+	void pins_changed(uint8_t port, uint8_t changed) {
+		static const uint8_t lcd_pins[] = {LCD_PINS_RS, LCD_PINS_ENABLE, LCD_PINS_D4, LCD_PINS_D5, LCD_PINS_D6, LCD_PINS_D7};
+		for (uint8_t pin : lcd_pins) {
+			if (pin_in(pin, port, changed))
+				bucket_owner(BUCKET_LCD);
+		}
+		if (pin_in(LCD_PINS_ENABLE, port, changed) && !pin_level(LCD_PINS_ENABLE))
+			lcd_latch();
+		if (pin_in(MCP_SS_PIN, port, changed))
+			spi_select(SPI_MCP, !pin_level(MCP_SS_PIN));
+		if (pin_in(CS_PIN, port, changed))
+			spi_select(SPI_TMC, !pin_level(CS_PIN));
+		if (pin_in(STEP_PIN, port, changed))
+			step_edge(pin_level(STEP_PIN));
+		if (pin_in(FAN1_PWM_PIN, port, changed) || pin_in(FAN2_PWM_PIN, port, changed))
+			fans_update();
+	}
+
+	void board_init() {
+		physics_at = now() + PHYSICS_TICK_MS * CYCLES_PER_MS;
+	}
+
+	uint64_t board_next_event() {
+		uint64_t at = physics_at;
+		for (const fan_t& fan : fans) {
+			if (fan.next_edge < at)
+				at = fan.next_edge;
+		}
+		return at;
+	}
+
+	void board_event(uint64_t at) {
+		if (physics_at <= at) {
+			physics_step();
+			physics_at += PHYSICS_TICK_MS * CYCLES_PER_MS;
+		}
+		for (fan_t& fan : fans) {
+			if (fan.next_edge <= at) {
+				external_interrupt(fan.interrupt);
+				fan.next_edge = fan.rpm < 60 ? NEVER : at + fan_period(fan);
+			}
+		}
+	}
+
+}
@@ -0,0 +1,1027 @@
+// Simulated ATmega32U4 core for the host build: clock, interrupts, timers,
+// GPIO, ADC, EEPROM, watchdog and the parts of the Arduino core the firmware
+// calls. Board devices (LCD, expander, driver, fans, thermistors) are in board.cpp.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <avr/wdt.h>
+#include <avr/eeprom.h>
+
+#include "sim.h"
+
+// estimated costs in CPU cycles (avr-gcc -Os, Arduino core 1.8)
+#define COST_PIN_MODE		70
+#define COST_DIGITAL_WRITE	56
+#define COST_DIGITAL_READ	50
+#define COST_ANALOG_WRITE	60
+#define COST_MILLIS			30
+#define COST_SPI_BYTE		8	// on top of the 8 SPI clocks
+#define COST_SPI_SETUP		10
+#define COST_ISR_ENTRY		20	// vector jump and prologue
+#define COST_ISR_EXIT		20	// epilogue and reti
+#define COST_ATTACHED_ISR	40	// WInterrupts dispatch through a function pointer
+#define COST_TIMER0_OVF		70	// Arduino core millis() update
+#define COST_WAKEUP			4	// idle sleep wake-up on top of the interrupt response
+
+#define NEVER UINT64_MAX
+
+uint8_t host_sram[HOST_SRAM_SIZE];
+
+enum port_t : uint8_t {PORT_B, PORT_C, PORT_D, PORT_E, PORT_F, PORTS};
+
+static void port_hook_b(uint8_t);
+static void port_hook_c(uint8_t);
+static void port_hook_d(uint8_t);
+static void port_hook_e(uint8_t);
+static void port_hook_f(uint8_t);
+static void pin_hook_b(uint8_t);
+static void pin_hook_c(uint8_t);
+static void pin_hook_d(uint8_t);
+static void pin_hook_e(uint8_t);
+static void pin_hook_f(uint8_t);
+static uint8_t pin_read_b();
+static uint8_t pin_read_c();
+static uint8_t pin_read_d();
+static uint8_t pin_read_e();
+static uint8_t pin_read_f();
+static void sreg_hook(uint8_t);
+static void eifr_hook(uint8_t);
+static void tifr0_hook(uint8_t);
+static void tifr3_hook(uint8_t);
+static void tccr0b_hook(uint8_t);
+static uint8_t tcnt0_read();
+static void tccr3a_hook(uint8_t);
+static void tccr3b_hook(uint8_t);
+static void tccr3c_hook(uint8_t);
+static void tcnt3_hook(uint16_t);
+static void ocr3a_hook(uint16_t);
+static uint16_t tcnt3_read();
+static void adcsra_hook(uint8_t);
+static uint8_t adcl_read();
+static uint8_t adch_read();
+static void eecr_hook(uint8_t);
+static uint8_t eecr_read();
+
+host_reg<uint8_t> SREG = {0, sreg_hook, nullptr};
+host_reg<uint8_t> MCUSR = {_BV(PORF), nullptr, nullptr};
+host_reg<uint8_t> SMCR = {0, nullptr, nullptr};
+host_reg<uint8_t> WDTCSR = {0, nullptr, nullptr};
+
+host_reg<uint8_t> PINB = {0, pin_hook_b, pin_read_b};
+host_reg<uint8_t> DDRB = {0, port_hook_b, nullptr};
+host_reg<uint8_t> PORTB = {0, port_hook_b, nullptr};
+host_reg<uint8_t> PINC = {0, pin_hook_c, pin_read_c};
+host_reg<uint8_t> DDRC = {0, port_hook_c, nullptr};
+host_reg<uint8_t> PORTC = {0, port_hook_c, nullptr};
+host_reg<uint8_t> PIND = {0, pin_hook_d, pin_read_d};
+host_reg<uint8_t> DDRD = {0, port_hook_d, nullptr};
+host_reg<uint8_t> PORTD = {0, port_hook_d, nullptr};
+host_reg<uint8_t> PINE = {0, pin_hook_e, pin_read_e};
+host_reg<uint8_t> DDRE = {0, port_hook_e, nullptr};
+host_reg<uint8_t> PORTE = {0, port_hook_e, nullptr};
+host_reg<uint8_t> PINF = {0, pin_hook_f, pin_read_f};
+host_reg<uint8_t> DDRF = {0, port_hook_f, nullptr};
+host_reg<uint8_t> PORTF = {0, port_hook_f, nullptr};
+
+host_reg<uint8_t> EIMSK = {0, nullptr, nullptr};
+host_reg<uint8_t> EIFR = {0, eifr_hook, nullptr};
+host_reg<uint8_t> EICRA = {0, nullptr, nullptr};
+host_reg<uint8_t> EICRB = {0, nullptr, nullptr};
+
+host_reg<uint8_t> TCCR0A = {0, nullptr, nullptr};
+host_reg<uint8_t> TCCR0B = {0, tccr0b_hook, nullptr};
+host_reg<uint8_t> TCNT0 = {0, nullptr, tcnt0_read};
+host_reg<uint8_t> OCR0A = {0, nullptr, nullptr};
+host_reg<uint8_t> OCR0B = {0, nullptr, nullptr};
+host_reg<uint8_t> TIMSK0 = {0, nullptr, nullptr};
+host_reg<uint8_t> TIFR0 = {0, tifr0_hook, nullptr};
+
+host_reg<uint8_t> TCCR1A = {0, nullptr, nullptr};
+host_reg<uint8_t> TCCR1B = {0, nullptr, nullptr};
+host_reg<uint16_t> OCR1A = {0, nullptr, nullptr};
+
+host_reg<uint8_t> TCCR3A = {0, tccr3a_hook, nullptr};
+host_reg<uint8_t> TCCR3B = {0, tccr3b_hook, nullptr};
+host_reg<uint8_t> TCCR3C = {0, tccr3c_hook, nullptr};
+host_reg<uint16_t> TCNT3 = {0, tcnt3_hook, tcnt3_read};
+host_reg<uint16_t> OCR3A = {0, ocr3a_hook, nullptr};
+host_reg<uint8_t> TIMSK3 = {0, nullptr, nullptr};
+host_reg<uint8_t> TIFR3 = {0, tifr3_hook, nullptr};
+
+host_reg<uint8_t> TCCR4A = {0, nullptr, nullptr};
+host_reg<uint8_t> TCCR4B = {0, nullptr, nullptr};
+host_reg<uint8_t> TCCR4C = {0, nullptr, nullptr};
+host_reg<uint8_t> TCCR4D = {0, nullptr, nullptr};
+host_reg<uint8_t> OCR4A = {0, nullptr, nullptr};
+host_reg<uint8_t> OCR4D = {0, nullptr, nullptr};
+
+host_reg<uint8_t> ADMUX = {0, nullptr, nullptr};
+host_reg<uint8_t> ADCSRA = {0, adcsra_hook, nullptr};
+host_reg<uint8_t> ADCSRB = {0, nullptr, nullptr};
+host_reg<uint8_t> DIDR0 = {0, nullptr, nullptr};
+host_reg<uint16_t> ADC = {0, nullptr, nullptr};
+host_reg<uint8_t> ADCL = {0, nullptr, adcl_read};
+host_reg<uint8_t> ADCH = {0, nullptr, adch_read};
+
+host_reg<uint8_t> EECR = {0, eecr_hook, eecr_read};
+host_reg<uint8_t> EEDR = {0, nullptr, nullptr};
+host_reg<uint16_t> EEAR = {0, nullptr, nullptr};
+
+host_reg<uint8_t> SPCR = {0, nullptr, nullptr};
+host_reg<uint8_t> SPSR = {0, nullptr, nullptr};
+host_reg<uint8_t> SPDR = {0, nullptr, nullptr};
+
+SPIClass SPI;
+
+// firmware interrupt handlers, whichever the build defines
+extern "C" void host_vect_TIMER0_COMPA(void) __attribute__((weak));
+extern "C" void host_vect_ADC(void) __attribute__((weak));
+extern "C" void host_vect_EE_READY(void) __attribute__((weak));
+extern "C" void host_vect_TIMER3_COMPA(void) __attribute__((weak));
+
+namespace Sim {
+
+	counters_t counters;
+
+	struct port_regs_t {
+		host_reg<uint8_t>* port;
+		host_reg<uint8_t>* ddr;
+		host_reg<uint8_t>* pin;
+	};
+
+	static const port_regs_t ports[PORTS] = {
+		{&PORTB, &DDRB, &PINB},
+		{&PORTC, &DDRC, &PINC},
+		{&PORTD, &DDRD, &PIND},
+		{&PORTE, &DDRE, &PINE},
+		{&PORTF, &DDRF, &PINF},
+	};
+
+	// Leonardo variant pin map, see lib/pins_arduino.h
+	static const uint8_t pin_ports[32] = {
+		PORT_D, PORT_D, PORT_D, PORT_D, PORT_D, PORT_C, PORT_D, PORT_E,
+		PORT_B, PORT_B, PORT_B, PORT_B, PORT_D, PORT_C, PORT_B, PORT_B,
+		PORT_B, PORT_B, PORT_F, PORT_F, PORT_F, PORT_F, PORT_F, PORT_F,
+		PORT_D, PORT_D, PORT_B, PORT_B, PORT_B, PORT_D, PORT_D, PORT_E,
+	};
+
+	static const uint8_t pin_bits[32] = {
+		2, 3, 1, 0, 4, 6, 7, 6,
+		4, 5, 6, 7, 6, 7, 3, 1,
+		2, 0, 7, 6, 5, 4, 1, 0,
+		4, 7, 4, 5, 6, 6, 5, 2,
+	};
+
+	static const uint8_t analog_channels[12] = {7, 6, 5, 4, 1, 0, 8, 10, 11, 12, 13, 9};
+
+	static uint8_t port_levels[PORTS];
+	static uint8_t ext_driven[PORTS];
+	static uint8_t ext_level[PORTS];
+	static bool oc3a;
+
+	static uint8_t isr_depth;
+	static bucket_t owner;
+
+	static uint64_t t0_base;
+	static bool t0_running;
+	static bool t0_compa_done;
+	static unsigned long timer0_overflow_count;
+	static unsigned long timer0_millis;
+	static uint8_t timer0_fract;
+
+	static uint32_t t3_prescale;
+	static uint64_t t3_zero;
+	static uint16_t t3_held;
+	static uint16_t t3_ocr_buffer;
+	static bool t3_ocr_pending;
+
+	static uint64_t adc_done_at = NEVER;
+	static uint8_t adc_channel;
+
+	static uint8_t eeprom[E2END + 1];
+	static bool eeprom_erased;
+	static uint64_t eeprom_busy_until;
+	static bool eeprom_busy;
+
+	static uint64_t wdt_deadline = NEVER;
+	static uint32_t wdt_timeout;
+
+	static void (*int_funcs[5])();
+
+	struct scheduled_t {
+		uint64_t at;
+		action_t action;
+	};
+	static scheduled_t scheduled[256];
+	static uint8_t scheduled_count;
+
+	uint64_t now() {
+		return counters.cycles;
+	}
+
+	static void account(bucket_t bucket, uint64_t cycles) {
+		counters.cycles += cycles;
+		counters.bucket[isr_depth ? BUCKET_ISR : bucket] += cycles;
+	}
+
+	void bucket_owner(bucket_t bucket) {
+		owner = bucket;
+	}
+
+	uint8_t pin_port(uint8_t pin) {
+		return pin_ports[pin];
+	}
+
+	uint8_t pin_mask(uint8_t pin) {
+		return 1 << pin_bits[pin];
+	}
+
+	/*** GPIO ***/
+
+	static uint8_t level(uint8_t port) {
+		uint8_t ddr = ports[port].ddr->value;
+		uint8_t out = ports[port].port->value;
+		uint8_t in = ~ddr;
+		uint8_t v = (out & ddr) | (in & ext_driven[port] & ext_level[port]) | (in & ~ext_driven[port] & out);
+		if (port == PORT_C && (TCCR3A.value & (_BV(COM3A1) | _BV(COM3A0))) && (ddr & _BV(PC6))) {
+			v = oc3a ? v | _BV(PC6) : v & ~_BV(PC6);
+		}
+		return v;
+	}
+
+	static void port_update(uint8_t port) {
+		uint8_t v = level(port);
+		uint8_t changed = v ^ port_levels[port];
+		port_levels[port] = v;
+		if (changed) {
+			pins_changed(port, changed);
+		}
+	}
+
+	void drive_pin(uint8_t pin, bool v) {
+		uint8_t port = pin_ports[pin];
+		uint8_t mask = 1 << pin_bits[pin];
+		ext_driven[port] |= mask;
+		ext_level[port] = v ? ext_level[port] | mask : ext_level[port] & ~mask;
+		port_update(port);
+	}
+
+	bool pin_level(uint8_t pin) {
+		return port_levels[pin_ports[pin]] & (1 << pin_bits[pin]);
+	}
+
+	/*** interrupts ***/
+
+	static bool ee_ready() {
+		return !eeprom_busy;
+	}
+
+	static bool vector_pending(uint8_t v) {
+		switch (v) {
+			case VECT_INT0: return EIFR.value & EIMSK.value & _BV(INT0);
+			case VECT_INT1: return EIFR.value & EIMSK.value & _BV(INT1);
+			case VECT_INT2: return EIFR.value & EIMSK.value & _BV(INT2);
+			case VECT_INT3: return EIFR.value & EIMSK.value & _BV(INT3);
+			case VECT_INT6: return EIFR.value & EIMSK.value & _BV(INT6);
+			case VECT_TIMER0_COMPA: return TIFR0.value & TIMSK0.value & _BV(OCF0A);
+			case VECT_TIMER0_OVF: return TIFR0.value & TIMSK0.value & _BV(TOV0);
+			case VECT_ADC: return (ADCSRA.value & _BV(ADIF)) && (ADCSRA.value & _BV(ADIE));
+			case VECT_EE_READY: return (EECR.value & _BV(EERIE)) && ee_ready();
+			case VECT_TIMER3_COMPA: return TIFR3.value & TIMSK3.value & _BV(OCF3A);
+		}
+		return false;
+	}
+
+	static void timer0_overflow() {
+		// Arduino core TIMER0_OVF_vect
+		unsigned long m = timer0_millis;
+		uint8_t f = timer0_fract;
+		m += 1;
+		f += 3;
+		if (f >= 125) {
+			f -= 125;
+			m += 1;
+		}
+		timer0_fract = f;
+		timer0_millis = m;
+		timer0_overflow_count++;
+		advance(BUCKET_ISR, COST_TIMER0_OVF);
+	}
+
+	static void vector_run(uint8_t v) {
+		static const uint8_t int_numbers[5] = {INT0, INT1, INT2, INT3, INT6};
+		switch (v) {
+			case VECT_INT0:
+			case VECT_INT1:
+			case VECT_INT2:
+			case VECT_INT3:
+			case VECT_INT6:
+				EIFR.value &= ~_BV(int_numbers[v - VECT_INT0]);
+				advance(BUCKET_ISR, COST_ATTACHED_ISR);
+				if (int_funcs[v - VECT_INT0])
+					int_funcs[v - VECT_INT0]();
+				break;
+			case VECT_TIMER0_COMPA:
+				TIFR0.value &= ~_BV(OCF0A);
+				if (host_vect_TIMER0_COMPA)
+					host_vect_TIMER0_COMPA();
+				break;
+			case VECT_TIMER0_OVF:
+				TIFR0.value &= ~_BV(TOV0);
+				timer0_overflow();
+				break;
+			case VECT_ADC:
+				ADCSRA.value &= ~_BV(ADIF);
+				if (host_vect_ADC)
+					host_vect_ADC();
+				break;
+			case VECT_EE_READY:
+				if (host_vect_EE_READY)
+					host_vect_EE_READY();
+				break;
+			case VECT_TIMER3_COMPA:
+				TIFR3.value &= ~_BV(OCF3A);
+				if (host_vect_TIMER3_COMPA)
+					host_vect_TIMER3_COMPA();
+				break;
+		}
+	}
+
+	static void service() {
+		while (SREG.value & _BV(SREG_I)) {
+			uint8_t v = 0;
+			while (v < VECTORS && !vector_pending(v))
+				++v;
+			if (v == VECTORS)
+				return;
+			SREG.value &= ~_BV(SREG_I);
+			++isr_depth;
+			++counters.isr_calls[v];
+			advance(BUCKET_ISR, COST_ISR_ENTRY);
+			vector_run(v);
+			advance(BUCKET_ISR, COST_ISR_EXIT);
+			--isr_depth;
+			SREG.value |= _BV(SREG_I);
+		}
+	}
+
+	void external_interrupt(uint8_t number) {
+		if (EIMSK.value & _BV(number))
+			EIFR.value |= _BV(number);
+	}
+
+	/*** timer 0 (Arduino time base, 1 ms control tick) ***/
+
+	static uint64_t t0_compa_at() {
+		if (!t0_running || t0_compa_done)
+			return NEVER;
+		return t0_base + (uint64_t)OCR0A.value * 64;
+	}
+
+	static uint64_t t0_ovf_at() {
+		return t0_running ? t0_base + 256 * 64 : NEVER;
+	}
+
+	static void adc_start();
+
+	static void t0_compa() {
+		t0_compa_done = true;
+		TIFR0.value |= _BV(OCF0A);
+		if ((ADCSRA.value & _BV(ADATE)) && (ADCSRB.value & 0x0F) == 3 && adc_done_at == NEVER) {
+			adc_start();
+		}
+	}
+
+	static void t0_ovf() {
+		t0_base += 256 * 64;
+		t0_compa_done = false;
+		TIFR0.value |= _BV(TOV0);
+	}
+
+	/*** timer 3 (stepper), CTC or fast PWM with TOP = OCR3A ***/
+
+	static uint32_t t3_clock_prescale() {
+		static const uint16_t prescale[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+		return prescale[TCCR3B.value & 0x07];
+	}
+
+	static uint16_t t3_count() {
+		if (!t3_prescale)
+			return t3_held;
+		if (now() < t3_zero)
+			return OCR3A.value;
+		return (now() - t3_zero) / t3_prescale;
+	}
+
+	static void t3_set_count(uint16_t count) {
+		if (t3_prescale)
+			t3_zero = now() - (uint64_t)count * t3_prescale;
+		else
+			t3_held = count;
+	}
+
+	static uint64_t t3_match_at() {
+		if (!t3_prescale)
+			return NEVER;
+		uint64_t at = t3_zero + (uint64_t)OCR3A.value * t3_prescale;
+		if (at < now())
+			at += 65536ULL * t3_prescale;
+		return at;
+	}
+
+	static void t3_compare_output() {
+		switch ((TCCR3A.value >> COM3A0) & 0x03) {
+			case 1: oc3a = !oc3a; break;
+			case 2: oc3a = false; break;
+			case 3: oc3a = true; break;
+			default: return;
+		}
+		port_update(PORT_C);
+	}
+
+	// fast PWM with TOP = OCR3A (mode 15) updates OCR3A at TOP
+	static bool t3_double_buffered() {
+		return (TCCR3A.value & (_BV(WGM31) | _BV(WGM30))) == (_BV(WGM31) | _BV(WGM30))
+			&& (TCCR3B.value & (_BV(WGM33) | _BV(WGM32))) == (_BV(WGM33) | _BV(WGM32));
+	}
+
+	static void t3_match(uint64_t at) {
+		t3_zero = at + t3_prescale;
+		if (t3_ocr_pending) {
+			OCR3A.value = t3_ocr_buffer;
+			t3_ocr_pending = false;
+		}
+		TIFR3.value |= _BV(OCF3A);
+		t3_compare_output();
+	}
+
+	/*** ADC ***/
+
+	static void adc_start() {
+		static const uint8_t prescale[8] = {2, 2, 4, 8, 16, 32, 64, 128};
+		adc_channel = (ADMUX.value & 0x07) | ((ADCSRB.value & _BV(MUX5)) ? 8 : 0);
+		ADCSRA.value |= _BV(ADSC);
+		adc_done_at = now() + 13 * prescale[ADCSRA.value & 0x07];
+	}
+
+	static void adc_done() {
+		adc_done_at = NEVER;
+		++counters.adc_conversions;
+		ADC.value = adc_sample(adc_channel);
+		ADCSRA.value = (ADCSRA.value & ~_BV(ADSC)) | _BV(ADIF);
+		if ((ADCSRA.value & _BV(ADATE)) && (ADCSRB.value & 0x0F) == 0) {
+			adc_start();
+		}
+	}
+
+	/*** EEPROM ***/
+
+	static void eeprom_erase() {
+		if (!eeprom_erased) {
+			memset(eeprom, 0xFF, sizeof(eeprom));
+			eeprom_erased = true;
+		}
+	}
+
+	static uint64_t eeprom_done_at() {
+		return eeprom_busy ? eeprom_busy_until : NEVER;
+	}
+
+	/*** clock ***/
+
+	static uint64_t next_event() {
+		uint64_t at = t0_compa_at();
+		uint64_t t = t0_ovf_at();
+		if (t < at) at = t;
+		t = t3_match_at();
+		if (t < at) at = t;
+		if (adc_done_at < at) at = adc_done_at;
+		t = eeprom_done_at();
+		if (t < at) at = t;
+		if (wdt_deadline < at) at = wdt_deadline;
+		if (scheduled_count && scheduled[0].at < at) at = scheduled[0].at;
+		t = board_next_event();
+		if (t < at) at = t;
+		return at;
+	}
+
+	static void fire_events(uint64_t at) {
+		if (t0_compa_at() <= at)
+			t0_compa();
+		if (t0_ovf_at() <= at)
+			t0_ovf();
+		uint64_t t = t3_match_at();
+		if (t <= at)
+			t3_match(t);
+		if (adc_done_at <= at)
+			adc_done();
+		if (eeprom_done_at() <= at)
+			eeprom_busy = false;
+		if (wdt_deadline <= at) {
+			++counters.wdt_expired;
+			wdt_deadline = at + wdt_timeout;
+		}
+		while (scheduled_count && scheduled[0].at <= at) {
+			action_t action = scheduled[0].action;
+			--scheduled_count;
+			memmove(scheduled, scheduled + 1, scheduled_count * sizeof(scheduled_t));
+			action();
+		}
+		if (board_next_event() <= at)
+			board_event(at);
+	}
+
+	void advance(bucket_t bucket, uint32_t cycles) {
+		uint64_t end = counters.cycles + cycles;
+		for (;;) {
+			uint64_t at = next_event();
+			if (at > end)
+				break;
+			if (at > counters.cycles)
+				account(bucket, at - counters.cycles);
+			fire_events(at);
+			uint64_t before = counters.cycles;
+			service();
+			// the interrupted work continues after the handler
+			end += counters.cycles - before;
+		}
+		account(bucket, end - counters.cycles);
+	}
+
+	void wait_until(bucket_t bucket, uint64_t at) {
+		while (counters.cycles < at) {
+			advance(bucket, at - counters.cycles < 64 ? at - counters.cycles : 64);
+		}
+	}
+
+	void schedule(uint64_t at, action_t action) {
+		uint8_t i = scheduled_count;
+		if (i == sizeof(scheduled) / sizeof(scheduled[0])) {
+			fprintf(stderr, "sim: too many scheduled actions\n");
+			return;
+		}
+		while (i && scheduled[i - 1].at > at) {
+			scheduled[i] = scheduled[i - 1];
+			--i;
+		}
+		scheduled[i] = {at, action};
+		++scheduled_count;
+	}
+
+	counters_t delta(const counters_t& now, const counters_t& then) {
+		counters_t d;
+		d.cycles = now.cycles - then.cycles;
+		for (uint8_t i = 0; i < BUCKET_COUNT; ++i)
+			d.bucket[i] = now.bucket[i] - then.bucket[i];
+		for (uint8_t i = 0; i < VECTORS; ++i)
+			d.isr_calls[i] = now.isr_calls[i] - then.isr_calls[i];
+		for (uint8_t i = 0; i < SPI_DEVICES; ++i) {
+			d.spi_transactions[i] = now.spi_transactions[i] - then.spi_transactions[i];
+			d.spi_bytes[i] = now.spi_bytes[i] - then.spi_bytes[i];
+		}
+		d.lcd_bytes = now.lcd_bytes - then.lcd_bytes;
+		d.lcd_busy_violations = now.lcd_busy_violations - then.lcd_busy_violations;
+		d.steps = now.steps - then.steps;
+		d.adc_conversions = now.adc_conversions - then.adc_conversions;
+		d.eeprom_writes = now.eeprom_writes - then.eeprom_writes;
+		d.wdt_expired = now.wdt_expired - then.wdt_expired;
+		d.pgm_reads = now.pgm_reads - then.pgm_reads;
+		return d;
+	}
+
+	/*** register hooks ***/
+
+	static void pin_toggle(uint8_t port) {
+		// writing one to PINx toggles PORTx
+		ports[port].port->store(ports[port].port->value ^ ports[port].pin->value);
+	}
+
+	static void tccr0b() {
+		bool running = TCCR0B.value & 0x07;
+		if (running && !t0_running) {
+			t0_base = now();
+			t0_compa_done = false;
+		}
+		t0_running = running;
+	}
+
+	static uint8_t tcnt0() {
+		return t0_running ? (now() - t0_base) / 64 : 0;
+	}
+
+	static void tccr3b() {
+		uint16_t count = t3_count();
+		t3_prescale = t3_clock_prescale();
+		t3_set_count(count);
+	}
+
+	static void adcsra(uint8_t old_value) {
+		uint8_t v = ADCSRA.value;
+		bool start = (v & _BV(ADSC)) && !(old_value & _BV(ADSC));
+		// ADIF is cleared by writing one to it, ADSC can't be cleared by software
+		v = (v & ~(_BV(ADIF) | _BV(ADSC))) | (old_value & ~v & _BV(ADIF)) | (old_value & _BV(ADSC));
+		ADCSRA.value = v;
+		if (start && (v & _BV(ADEN)))
+			adc_start();
+	}
+
+	static void eecr(uint8_t old_value) {
+		uint8_t v = EECR.value;
+		eeprom_erase();
+		if (v & _BV(EERE)) {
+			EEDR.value = eeprom[EEAR.value & E2END];
+			advance(BUCKET_EEPROM, 4);
+		}
+		if ((v & _BV(EEPE)) && (old_value & _BV(EEMPE)) && !eeprom_busy) {
+			eeprom[EEAR.value & E2END] = EEDR.value;
+			eeprom_busy = true;
+			eeprom_busy_until = now() + 3400 * CYCLES_PER_US;
+			++counters.eeprom_writes;
+			v &= ~_BV(EEMPE);
+		}
+		EECR.value = v & ~(_BV(EERE) | _BV(EEPE));
+	}
+
+	static uint8_t eecr_value() {
+		return eeprom_busy ? EECR.value | _BV(EEPE) : EECR.value;
+	}
+
+	static void sreg() {
+		if (SREG.value & _BV(SREG_I))
+			service();
+	}
+
+	static uint32_t spi_byte_cycles() {
+		static const uint8_t divider[4] = {4, 16, 64, 128};
+		uint32_t d = divider[SPCR.value & 0x03];
+		if (SPSR.value & _BV(SPI2X))
+			d /= 2;
+		return 8 * d;
+	}
+
+	/*** Arduino core ***/
+
+	static unsigned long millis_now() {
+		return timer0_millis;
+	}
+
+	static unsigned long micros_now() {
+		unsigned long m = timer0_overflow_count;
+		uint8_t t = tcnt0();
+		if ((TIFR0.value & _BV(TOV0)) && (t < 255))
+			m++;
+		return ((m << 8) + t) * 4;
+	}
+
+	static void attach(uint8_t number, void (*func)(), int mode) {
+		static const uint8_t int_numbers[5] = {INT0, INT1, INT2, INT3, INT6};
+		if (number >= 5)
+			return;
+		int_funcs[number] = func;
+		if (number < 4)
+			EICRA.value = (EICRA.value & ~(3 << (2 * number))) | (mode << (2 * number));
+		else
+			EICRB.value = (EICRB.value & ~(3 << ISC60)) | (mode << ISC60);
+		EIMSK.value |= _BV(int_numbers[number]);
+	}
+
+	static void pwm_off(uint8_t pin) {
+		switch (pin) {
+			case 3: TCCR0A.value &= ~_BV(COM0B1); break;
+			case 5: TCCR3A.store(TCCR3A.value & ~_BV(COM3A1)); break;
+			case 6: TCCR4C.value &= ~_BV(COM4D1); break;
+			case 9: TCCR1A.value &= ~_BV(COM1A1); break;
+			case 11: TCCR0A.value &= ~_BV(COM0A1); break;
+			case 13: TCCR4A.value &= ~_BV(COM4A1); break;
+		}
+	}
+
+	uint8_t pwm_value(uint8_t pin) {
+		switch (pin) {
+			case 3: if (TCCR0A.value & _BV(COM0B1)) return OCR0B.value; break;
+			case 6: if (TCCR4C.value & _BV(COM4D1)) return OCR4D.value; break;
+			case 9: if (TCCR1A.value & _BV(COM1A1)) return OCR1A.value; break;
+			case 11: if (TCCR0A.value & _BV(COM0A1)) return OCR0A.value; break;
+			case 13: if (TCCR4A.value & _BV(COM4A1)) return OCR4A.value; break;
+		}
+		return pin_level(pin) ? 255 : 0;
+	}
+
+	static void pin_write(uint8_t pin, uint8_t val) {
+		host_reg<uint8_t>* port = ports[pin_ports[pin]].port;
+		uint8_t mask = 1 << pin_bits[pin];
+		port->store(val ? port->value | mask : port->value & ~mask);
+	}
+
+	static void pin_mode(uint8_t pin, uint8_t mode) {
+		const port_regs_t& regs = ports[pin_ports[pin]];
+		uint8_t mask = 1 << pin_bits[pin];
+		if (mode == OUTPUT) {
+			regs.ddr->store(regs.ddr->value | mask);
+		} else {
+			regs.ddr->store(regs.ddr->value & ~mask);
+			regs.port->store(mode == INPUT_PULLUP ? regs.port->value | mask : regs.port->value & ~mask);
+		}
+	}
+
+	static void wdt_start(uint8_t timeout) {
+		static const uint16_t timeouts_ms[10] = {15, 30, 60, 120, 250, 500, 1000, 2000, 4000, 8000};
+		wdt_timeout = timeouts_ms[timeout < 10 ? timeout : 9] * CYCLES_PER_MS;
+		wdt_deadline = now() + wdt_timeout;
+	}
+
+}
+
+using namespace Sim;
+
+static void port_hook_b(uint8_t) { port_update(PORT_B); }
+static void port_hook_c(uint8_t) { port_update(PORT_C); }
+static void port_hook_d(uint8_t) { port_update(PORT_D); }
+static void port_hook_e(uint8_t) { port_update(PORT_E); }
+static void port_hook_f(uint8_t) { port_update(PORT_F); }
+static void pin_hook_b(uint8_t) { pin_toggle(PORT_B); }
+static void pin_hook_c(uint8_t) { pin_toggle(PORT_C); }
+static void pin_hook_d(uint8_t) { pin_toggle(PORT_D); }
+static void pin_hook_e(uint8_t) { pin_toggle(PORT_E); }
+static void pin_hook_f(uint8_t) { pin_toggle(PORT_F); }
+static uint8_t pin_read_b() { return level(PORT_B); }
+static uint8_t pin_read_c() { return level(PORT_C); }
+static uint8_t pin_read_d() { return level(PORT_D); }
+static uint8_t pin_read_e() { return level(PORT_E); }
+static uint8_t pin_read_f() { return level(PORT_F); }
+static void sreg_hook(uint8_t) { sreg(); }
+static void tccr0b_hook(uint8_t) { tccr0b(); }
+static uint8_t tcnt0_read() { return tcnt0(); }
+static void tccr3a_hook(uint8_t) { port_update(PORT_C); }
+static void tccr3b_hook(uint8_t) { tccr3b(); }
+static void tcnt3_hook(uint16_t) { t3_set_count(TCNT3.value); }
+static void ocr3a_hook(uint16_t old_value) {
+	if (t3_prescale && t3_double_buffered()) {
+		t3_ocr_buffer = OCR3A.value;
+		t3_ocr_pending = true;
+		OCR3A.value = old_value;
+	}
+}
+static uint16_t tcnt3_read() { return t3_count(); }
+static void adcsra_hook(uint8_t old_value) { adcsra(old_value); }
+static uint8_t adcl_read() { return ADC.value & 0xFF; }
+static uint8_t adch_read() { return ADC.value >> 8; }
+static void eecr_hook(uint8_t old_value) { eecr(old_value); }
+static uint8_t eecr_read() { return eecr_value(); }
+
+// flags are cleared by writing one to them
+static void eifr_hook(uint8_t old_value) { EIFR.value = old_value & ~EIFR.value; }
+static void tifr0_hook(uint8_t old_value) { TIFR0.value = old_value & ~TIFR0.value; }
+static void tifr3_hook(uint8_t old_value) { TIFR3.value = old_value & ~TIFR3.value; }
+
+static void tccr3c_hook(uint8_t) {
+	if (TCCR3C.value & _BV(FOC3A))
+		t3_compare_output();
+	TCCR3C.value = 0;
+}
+
+extern "C" void host_cycles(uint32_t cycles) {
+	advance(BUCKET_CPU, cycles);
+}
+
+extern "C" void host_sei(void) {
+	advance(BUCKET_CPU, 1);
+	SREG.value |= _BV(SREG_I);
+	service();
+}
+
+extern "C" void host_sleep(void) {
+	if (!(SMCR.value & _BV(SE)))
+		return;
+	// idle mode, clocks keep running until an enabled interrupt is handled
+	uint32_t handled = 0;
+	for (uint8_t v = 0; v < VECTORS; ++v)
+		handled += counters.isr_calls[v];
+	for (;;) {
+		uint32_t calls = 0;
+		for (uint8_t v = 0; v < VECTORS; ++v)
+			calls += counters.isr_calls[v];
+		if (calls != handled || !(SREG.value & _BV(SREG_I)))
+			break;
+		uint64_t at = next_event();
+		if (at == NEVER)
+			break;
+		advance(BUCKET_IDLE, at > now() ? at - now() : 0);
+	}
+	advance(BUCKET_CPU, COST_WAKEUP);
+}
+
+extern "C" void host_cli(void) {
+	advance(BUCKET_CPU, 1);
+	SREG.value &= ~_BV(SREG_I);
+}
+
+extern "C" const void* host_pgm_addr(const void* addr) {
+	static const char serial_number[] =
+	#ifdef CW1S
+		"02_HOSTSIM00001";
+	#else
+		"01_HOSTSIM00001";
+	#endif
+	static const uint8_t blank[32] = {0};
+	++counters.pgm_reads;
+	uintptr_t a = (uintptr_t)addr;
+	if (a > FLASHEND)
+		return addr;
+	if (a >= 0x7fe0 && a < 0x7fe0 + sizeof(serial_number))
+		return serial_number + (a - 0x7fe0);
+	return blank;
+}
+
+void init() {
+	sei();
+	TCCR0A = _BV(WGM01) | _BV(WGM00);
+	TCCR0B = _BV(CS01) | _BV(CS00);
+	TIMSK0 = _BV(TOIE0);
+	TCCR1B = _BV(CS11) | _BV(CS10);
+	TCCR1A = _BV(WGM10);
+	TCCR3B = _BV(CS31) | _BV(CS30);
+	TCCR3A = _BV(WGM30);
+	TCCR4B = _BV(2) | _BV(1) | _BV(0);
+	TCCR4D = _BV(0);
+	TCCR4C = _BV(PWM4D);
+	ADCSRA |= _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0) | _BV(ADEN);
+	board_init();
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+	advance(board_pin_bucket(pin), COST_PIN_MODE);
+	owner = board_pin_bucket(pin);
+	pin_mode(pin, mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+	advance(board_pin_bucket(pin), COST_DIGITAL_WRITE);
+	owner = board_pin_bucket(pin);
+	pwm_off(pin);
+	pin_write(pin, val);
+}
+
+int digitalRead(uint8_t pin) {
+	advance(board_pin_bucket(pin), COST_DIGITAL_READ);
+	pwm_off(pin);
+	return pin_level(pin) ? HIGH : LOW;
+}
+
+int analogRead(uint8_t pin) {
+	if (pin >= 18)
+		pin -= 18;
+	uint8_t channel = analog_channels[pin < 12 ? pin : 0];
+	ADCSRB = (ADCSRB & ~_BV(MUX5)) | (((channel >> 3) & 0x01) << MUX5);
+	ADMUX = _BV(REFS0) | (channel & 0x07);
+	ADCSRA |= _BV(ADSC);
+	while (ADCSRA.load() & _BV(ADSC))
+		advance(BUCKET_ADC, 4);
+	uint8_t low = ADCL;
+	uint8_t high = ADCH;
+	return (high << 8) | low;
+}
+
+void analogWrite(uint8_t pin, int val) {
+	pinMode(pin, OUTPUT);
+	if (val <= 0) {
+		digitalWrite(pin, LOW);
+	} else if (val >= 255) {
+		digitalWrite(pin, HIGH);
+	} else {
+		advance(board_pin_bucket(pin), COST_ANALOG_WRITE);
+		switch (pin) {
+			case 3: TCCR0A.value |= _BV(COM0B1); OCR0B.value = val; break;
+			case 6: TCCR4C.value |= _BV(COM4D1); OCR4D.value = val; break;
+			case 9: TCCR1A.value |= _BV(COM1A1); OCR1A.value = val; break;
+			case 11: TCCR0A.value |= _BV(COM0A1); OCR0A.value = val; break;
+			case 13: TCCR4A.value |= _BV(COM4A1); OCR4A.value = val; break;
+			default:
+				digitalWrite(pin, val < 128 ? LOW : HIGH);
+				return;
+		}
+		// the board watches PWM outputs through pin changes
+		pins_changed(pin_ports[pin], 1 << pin_bits[pin]);
+	}
+}
+
+unsigned long millis() {
+	advance(BUCKET_CPU, COST_MILLIS);
+	return millis_now();
+}
+
+unsigned long micros() {
+	advance(BUCKET_CPU, COST_MILLIS);
+	return micros_now();
+}
+
+void delay(unsigned long ms) {
+	unsigned long start = micros_now();
+	while (ms > 0) {
+		advance(owner, 16 * CYCLES_PER_US);
+		while (ms > 0 && (micros_now() - start) >= 1000) {
+			ms--;
+			start += 1000;
+		}
+	}
+}
+
+void delayMicroseconds(unsigned int us) {
+	advance(owner, us > 1 ? us * CYCLES_PER_US : 12);
+}
+
+void attachInterrupt(uint8_t number, void (*func)(void), int mode) {
+	advance(BUCKET_CPU, 60);
+	attach(number, func, mode);
+}
+
+void detachInterrupt(uint8_t number) {
+	static const uint8_t int_numbers[5] = {INT0, INT1, INT2, INT3, INT6};
+	advance(BUCKET_CPU, 40);
+	if (number < 5) {
+		EIMSK.value &= ~_BV(int_numbers[number]);
+		int_funcs[number] = nullptr;
+	}
+}
+
+void SPIClass::begin() {
+	advance(BUCKET_SPI, 100);
+	SPCR.value |= _BV(MSTR) | _BV(SPE);
+}
+
+void SPIClass::end() {
+	SPCR.value &= ~_BV(SPE);
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+	owner = BUCKET_SPI;
+	advance(BUCKET_SPI, spi_byte_cycles() + COST_SPI_BYTE);
+	return spi_exchange(data);
+}
+
+void SPIClass::setBitOrder(uint8_t bitOrder) {
+	advance(BUCKET_SPI, COST_SPI_SETUP);
+	SPCR.value = bitOrder == LSBFIRST ? SPCR.value | _BV(DORD) : SPCR.value & ~_BV(DORD);
+}
+
+void SPIClass::setDataMode(uint8_t dataMode) {
+	advance(BUCKET_SPI, COST_SPI_SETUP);
+	SPCR.value = (SPCR.value & ~SPI_MODE_MASK) | dataMode;
+}
+
+void SPIClass::setClockDivider(uint8_t clockDiv) {
+	advance(BUCKET_SPI, COST_SPI_SETUP);
+	SPCR.value = (SPCR.value & ~SPI_CLOCK_MASK) | (clockDiv & SPI_CLOCK_MASK);
+	SPSR.value = (SPSR.value & ~SPI_2XCLOCK_MASK) | ((clockDiv >> 2) & SPI_2XCLOCK_MASK);
+}
+
+extern "C" void wdt_enable(uint8_t timeout) {
+	advance(BUCKET_CPU, 10);
+	wdt_start(timeout);
+}
+
+extern "C" void wdt_disable(void) {
+	advance(BUCKET_CPU, 10);
+	wdt_deadline = NEVER;
+}
+
+extern "C" void wdt_reset(void) {
+	advance(BUCKET_CPU, 1);
+	if (wdt_deadline != NEVER)
+		wdt_deadline = now() + wdt_timeout;
+}
+
+extern "C" uint8_t eeprom_read_byte(const uint8_t* addr) {
+	while (EECR & _BV(EEPE))
+		advance(BUCKET_EEPROM, 4);
+	EEAR = (uintptr_t)addr;
+	EECR |= _BV(EERE);
+	return EEDR;
+}
+
+extern "C" void eeprom_write_byte(uint8_t* addr, uint8_t value) {
+	while (EECR & _BV(EEPE))
+		advance(BUCKET_EEPROM, 4);
+	EEAR = (uintptr_t)addr;
+	EEDR = value;
+	uint8_t sreg = SREG;
+	cli();
+	EECR |= _BV(EEMPE);
+	EECR |= _BV(EEPE);
+	SREG = sreg;
+}
+
+extern "C" void eeprom_update_byte(uint8_t* addr, uint8_t value) {
+	if (eeprom_read_byte(addr) != value)
+		eeprom_write_byte(addr, value);
+}
+
+extern "C" void eeprom_read_block(void* dst, const void* src, size_t n) {
+	uint8_t* d = (uint8_t*)dst;
+	const uint8_t* s = (const uint8_t*)src;
+	while (n--)
+		*d++ = eeprom_read_byte(s++);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+// Simulated CW1/CW1S board for the host build.
+//
+// Time is counted in 16 MHz CPU cycles. The Arduino API, register accesses and
+// the devices on the board charge an estimated cost, so the simulated clock
+// advances only through I/O and waiting; pure computation is not counted.
+
+#include <stdint.h>
+
+namespace Sim {
+
+	constexpr uint32_t CYCLES_PER_US = 16;
+	constexpr uint32_t CYCLES_PER_MS = 16000;
+
+	//! where the simulated time goes
+	enum bucket_t : uint8_t {
+		BUCKET_CPU,		// code, register access, pin writes not owned by a device
+		BUCKET_LCD,		// LCD pins and the delays following them
+		BUCKET_SPI,		// SPI bytes and chip selects
+		BUCKET_ADC,		// busy waiting for conversions
+		BUCKET_EEPROM,	// busy waiting for EEPROM
+		BUCKET_ISR,		// interrupt handlers including entry and exit
+		BUCKET_IDLE,	// sleeping
+		BUCKET_COUNT
+	};
+
+	enum spi_device_t : uint8_t {
+		SPI_MCP,
+		SPI_TMC,
+		SPI_DEVICES
+	};
+
+	//! in priority order (vector table order)
+	enum vector_t : uint8_t {
+		VECT_INT0,
+		VECT_INT1,
+		VECT_INT2,
+		VECT_INT3,
+		VECT_INT6,
+		VECT_TIMER0_COMPA,
+		VECT_TIMER0_OVF,
+		VECT_ADC,
+		VECT_EE_READY,
+		VECT_TIMER3_COMPA,
+		VECTORS
+	};
+
+	struct counters_t {
+		uint64_t cycles;
+		uint64_t bucket[BUCKET_COUNT];
+		uint32_t isr_calls[VECTORS];
+		uint32_t spi_transactions[SPI_DEVICES];
+		uint32_t spi_bytes[SPI_DEVICES];
+		uint32_t lcd_bytes;
+		uint32_t lcd_busy_violations;
+		uint32_t steps;
+		uint32_t adc_conversions;
+		uint32_t eeprom_writes;
+		uint32_t wdt_expired;
+		uint32_t pgm_reads;		// pgm_read_byte() and *_P() calls
+	};
+
+	extern counters_t counters;
+	counters_t delta(const counters_t& now, const counters_t& then);
+
+	typedef void (*action_t)();
+
+	// clock
+	uint64_t now();
+	void advance(bucket_t bucket, uint32_t cycles);
+	void wait_until(bucket_t bucket, uint64_t at);
+	void schedule(uint64_t at, action_t action);
+
+	// MCU pins (Arduino numbering)
+	void drive_pin(uint8_t pin, bool level);
+	bool pin_level(uint8_t pin);
+	uint8_t pwm_value(uint8_t pin);
+
+	// MCP23S17 pins (MCP_A0.. numbering, 1-16)
+	void mcp_drive(uint8_t pin, bool level);
+	bool mcp_output(uint8_t pin);
+	uint64_t mcp_output_changed(uint8_t pin);
+
+	// TMC2130
+	uint32_t tmc_register(uint8_t address);
+
+	// HD44780, 20x4 text with custom characters shown as '#'
+	const char* lcd_row(uint8_t row);
+
+	// environment
+	struct thermal_t {
+		float ambient;
+		float chamber;
+		float uvled;
+	};
+	extern thermal_t thermal;
+	extern float fan_health[3];		// 1 = new fan, share of its speed at any duty
+	uint16_t fan_rpm(uint8_t fan);
+
+	// glue between the MCU core and the board devices (sim.cpp <-> board.cpp)
+	uint8_t pin_port(uint8_t pin);
+	uint8_t pin_mask(uint8_t pin);
+	bucket_t board_pin_bucket(uint8_t pin);
+	void pins_changed(uint8_t port, uint8_t changed);
+	uint8_t spi_exchange(uint8_t data);
+	uint16_t adc_sample(uint8_t channel);
+	void board_init();
+	uint64_t board_next_event();
+	void board_event(uint64_t at);
+	void external_interrupt(uint8_t number);
+	void bucket_owner(bucket_t bucket);
+
+}
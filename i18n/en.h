@@ -62,6 +62,8 @@ static const char pgmstr_fan2_menu_speed[] PROGMEM = _("Fan2 menu speed");
 
 // fans menu
 static const char pgmstr_fans[] PROGMEM = _("Fans");
+static const char pgmstr_rpm_control[] PROGMEM = _("RPM control");
+static const char pgmstr_fans_calibration[] PROGMEM = _("Fans calibration");
 
 // info menu
 static const char pgmstr_information[] PROGMEM = _("Information");
@@ -101,6 +103,7 @@ static const char pgmstr_uvled_temp[] PROGMEM = _("UVLED temp.:");
 // advanced menu
 static const char pgmstr_cooldown[] PROGMEM = _("Cooldown");
 static const char pgmstr_selftest[] PROGMEM = _("Selftest");
+static const char pgmstr_heater_autotune[] PROGMEM = _("Heater autotune");
 
 // state menu
 static const char pgmstr_progress[] PROGMEM = { '|', '/', '-', BACKSLASH_CHAR };
@@ -150,4 +153,6 @@ static const char pgmstr_ipatank_test[] PROGMEM = _("IPA tank test");
 static const char pgmstr_cover_test[] PROGMEM = _("Cover test");
 static const char pgmstr_open_cover[] PROGMEM = _("Open the cover");
 static const char pgmstr_hold_platform[] PROGMEM = _("Hold the platform");
+static const char pgmstr_autotune_failed[] PROGMEM = _("Autotune failed");
+static const char pgmstr_gains_out_of_range[] PROGMEM = _("Gains out of range");
 static const char pgmstr_wrong_model[] PROGMEM = _("Incorrect firmware!");
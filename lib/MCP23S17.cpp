@@ -11,10 +11,14 @@
     I/O Direction
     Pull-up on/off
     Input inversion
-    Output write
+    Output write (single pins, masked group of pins or whole word)
     Input read
+    Interrupt on change (word based, IOCON interrupt options are left at defaults: INTA/INTB
+    not mirrored, active low push-pull)
+
+  Direction, pull-up, inversion and output registers are cached, writes not changing the cached
+  value are skipped.
 
-  Interrupt features are not implemented in this version
   byte based (portA, portB) functions are not implemented in this version
 
   NOTE:  Addresses below are only valid when IOCON.BANK=0 (register addressing mode)
@@ -93,6 +97,10 @@ void MCP::begin() {
   //SPI.setBitOrder(MSBFIRST);          // Sets SPI bus bit order (this is the default, setting it for good form!)
   //SPI.setDataMode(SPI_MODE0);         // Sets the SPI bus timing mode (this is the default, setting it for good form!)
   byteWrite(IOCON, ADDR_ENABLE);
+  wordWrite(IODIRA, _modeCache);        // The chip is not reset with the MCU, make it match the caches
+  wordWrite(GPPUA, _pullupCache);       // so the writes below can be skipped when nothing changes
+  wordWrite(IPOLA, _invertCache);
+  wordWrite(GPIOA, _outputCache);
 }
 
 // GENERIC BYTE WRITE - will write a byte to a register, arguments are register address and the value to write
@@ -120,15 +128,17 @@ void MCP::wordWrite(uint8_t reg, unsigned int word) {  // Accept the start regis
 
 void MCP::pinMode(uint8_t pin, uint8_t mode) {  // Accept the pin # and I/O mode
   if (pin < 1 || pin > 16) return;               // If the pin value is not valid (1-16) return, do nothing and return
+  unsigned int value = _modeCache;
   if (mode == INPUT) {                          // Determine the mode before changing the bit state in the mode cache
-    _modeCache |= 1 << (pin - 1);               // Since input = "HIGH", OR in a 1 in the appropriate place
+    value |= 1 << (pin - 1);                    // Since input = "HIGH", OR in a 1 in the appropriate place
   } else {
-    _modeCache &= ~(1 << (pin - 1));            // If not, the mode must be output, so and in a 0 in the appropriate place
+    value &= ~(1 << (pin - 1));                 // If not, the mode must be output, so and in a 0 in the appropriate place
   }
-  wordWrite(IODIRA, _modeCache);                // Call the generic word writer with start register and the mode cache
+  pinMode(value);
 }
 
 void MCP::pinMode(unsigned int mode) {     // Accept the word…
+  if (mode == _modeCache) return;          // Chip already has this configuration, skip the SPI transaction
   wordWrite(IODIRA, mode);                 // Call the the generic word writer with start register and the mode cache
   _modeCache = mode;
 }
@@ -139,16 +149,18 @@ void MCP::pinMode(unsigned int mode) {     // Accept the word…
 
 void MCP::pullupMode(uint8_t pin, uint8_t mode) {
   if (pin < 1 || pin > 16) return;
+  unsigned int value = _pullupCache;
   if (mode == ON) {
-    _pullupCache |= 1 << (pin - 1);
+    value |= 1 << (pin - 1);
   } else {
-    _pullupCache &= ~(1 << (pin -1));
+    value &= ~(1 << (pin -1));
   }
-  wordWrite(GPPUA, _pullupCache);
+  pullupMode(value);
 }
 
 
 void MCP::pullupMode(unsigned int mode) { 
+  if (mode == _pullupCache) return;
   wordWrite(GPPUA, mode);
   _pullupCache = mode;
 }
@@ -158,15 +170,17 @@ void MCP::pullupMode(unsigned int mode) {
 
 void MCP::inputInvert(uint8_t pin, uint8_t mode) {
   if (pin < 1 || pin > 16) return;
+  unsigned int value = _invertCache;
   if (mode == ON) {
-    _invertCache |= 1 << (pin - 1);
+    value |= 1 << (pin - 1);
   } else {
-    _invertCache &= ~(1 << (pin - 1));
+    value &= ~(1 << (pin - 1));
   }
-  wordWrite(IPOLA, _invertCache);
+  inputInvert(value);
 }
 
 void MCP::inputInvert(unsigned int mode) { 
+  if (mode == _invertCache) return;
   wordWrite(IPOLA, mode);
   _invertCache = mode;
 }
@@ -176,19 +190,20 @@ void MCP::inputInvert(unsigned int mode) {
 
 void MCP::digitalWrite(uint8_t pin, uint8_t value) {
   if (pin < 1 || pin > 16) return;
-  if (value) {
-    _outputCache |= 1 << (pin - 1);
-  } else {
-    _outputCache &= ~(1 << (pin - 1));
-  }
-  wordWrite(GPIOA, _outputCache);
+  unsigned int mask = 1 << (pin - 1);
+  digitalWriteMask(mask, value ? mask : 0);
 }
 
 void MCP::digitalWrite(unsigned int value) { 
+  if (value == _outputCache) return;        // Output latch already holds this value, skip the SPI transaction
   wordWrite(GPIOA, value);
   _outputCache = value;
 }
 
+void MCP::digitalWriteMask(unsigned int mask, unsigned int value) {  // Batch several pin changes into one write
+  digitalWrite((_outputCache & ~mask) | (value & mask));
+}
+
 
 // READ FUNCTIONS - BY WORD, BYTE AND BY PIN
 
@@ -213,6 +228,42 @@ uint8_t MCP::byteRead(uint8_t reg) {        // This function will read a single
   return value;                             // Return the constructed word, the format is 0x(register value)
 }
 
+// INTERRUPT ON CHANGE - word based, 0x(portB)(portA)
+
+void MCP::interruptEnable(unsigned int mask) {   // 1 = pin change generates interrupt (GPINTEN)
+  wordWrite(GPINTENA, mask);
+}
+
+void MCP::interruptControl(unsigned int mode) {  // 1 = compare against DEFVAL, 0 = against previous state (INTCON)
+  wordWrite(INTCONA, mode);
+}
+
+void MCP::interruptDefault(unsigned int value) { // Values compared against when INTCON bit is 1 (DEFVAL)
+  wordWrite(DEFVALA, value);
+}
+
+unsigned int MCP::interruptFlags(void) {     // Pins which caused pending interrupt (INTF), does not clear it
+  unsigned int value = 0;
+  ::digitalWrite(_ss, LOW);
+  SPI.transfer(OPCODER | (_address << 1));
+  SPI.transfer(INTFA);
+  value = SPI.transfer(0x00);
+  value |= (SPI.transfer(0x00) << 8);
+  ::digitalWrite(_ss, HIGH);
+  return value;
+}
+
+unsigned int MCP::interruptCapture(void) {  // Pin states when the pending interrupt occurred (INTCAP), reading clears it
+  unsigned int value = 0;
+  ::digitalWrite(_ss, LOW);
+  SPI.transfer(OPCODER | (_address << 1));
+  SPI.transfer(INTCAPA);
+  value = SPI.transfer(0x00);
+  value |= (SPI.transfer(0x00) << 8);
+  ::digitalWrite(_ss, HIGH);
+  return value;
+}
+
 uint8_t MCP::digitalRead(uint8_t pin) {                    // Return a single bit value, supply the necessary bit (1-16)
     if (pin < 1 || pin > 16) return 0x0;                    // If the pin value is not valid (1-16) return, do nothing and return
     return digitalRead() & (1 << (pin - 1)) ? HIGH : LOW;  // Call the word reading function, extract HIGH/LOW information from the requested pin
@@ -94,9 +94,16 @@ class MCP {
     void inputInvert(unsigned int);          // Selects input state inversion of all I/O pins at once (writing a 1 turns on inversion)
     void digitalWrite(uint8_t, uint8_t);     // Sets an individual output pin HIGH or LOW
     void digitalWrite(unsigned int);         // Sets all output pins at once. If some pins are configured as input, those bits will be ignored on write
+    void digitalWriteMask(unsigned int, unsigned int);  // Sets the output pins selected by mask at once, others keep their state
     uint8_t digitalRead(uint8_t);            // Reads an individual input pin
     uint8_t byteRead(uint8_t);               // Reads an individual register and returns the byte. Argument is the register address
     unsigned int digitalRead(void);          // Reads all input  pins at once. Be sure it ignore the value of pins configured as output!
+                                             // Reading GPIO clears pending interrupt on change of both ports
+    void interruptEnable(unsigned int);      // Selects pins generating interrupt on change, all pins at once
+    void interruptControl(unsigned int);     // Selects compare against DEFVAL (1) or previous state (0), all pins at once
+    void interruptDefault(unsigned int);     // Sets DEFVAL compare values, all pins at once
+    unsigned int interruptFlags(void);       // Reads pins which caused the pending interrupt
+    unsigned int interruptCapture(void);     // Reads pin states at the pending interrupt (INTCAP), clears it
   private:
     uint8_t _address;                        // Address of the MCP23S17 in use
 	uint8_t _ss;                             // Slave-select pin
@@ -12,7 +12,7 @@ v0.1 - it works
 */
 /**************************************************************************/
 #if ARDUINO >= 100
-#include "Arduino.h"
+#include <Arduino.h>
 #else
 #include "WProgram.h"
 #endif
@@ -26,6 +26,7 @@ Trinamic_TMC2130::Trinamic_TMC2130(uint8_t csPin)
 {
   _csPin=csPin;
   _status=0;
+  _shadow_valid=0;
 }
 
 // initialize the driver with its CS/SS pin
@@ -34,6 +35,10 @@ void Trinamic_TMC2130::init() {
   digitalWrite(_csPin, HIGH);
   init_SPI();
   read_STAT();
+  // readable shadows start from the chip, write-only ones on their first write
+  read_REG(TMC_REG_GCONF, &_gconf);
+  read_REG(TMC_REG_CHOPCONF, &_chopconf);
+  _shadow_valid = TMC_SHADOW_GCONF | TMC_SHADOW_CHOPCONF;
 }
 
 // initialize SPI
@@ -131,10 +136,28 @@ uint8_t Trinamic_TMC2130::alter_REG(uint8_t address, uint32_t data, uint32_t mas
   return _status;
 }
 
+// write a register through its RAM shadow, nothing is sent when the chip already holds data
+// (_status is then left from the last transfer)
+uint8_t Trinamic_TMC2130::write_shadow(uint8_t address, uint32_t *shadow, uint8_t flag, uint32_t data)
+{
+  if( (_shadow_valid&flag) && *shadow==data ){
+    return _status;
+  }
+
+  *shadow = data;
+  _shadow_valid |= flag;
+
+  write_REG( address, data );
+
+  return _status;
+}
+
 // set single bits in the GCONF register
 uint8_t Trinamic_TMC2130::set_GCONF(uint8_t position, uint8_t value)
 {
-  alter_REG(TMC_REG_GCONF, uint32_t(value)<<position, 0x1UL<<position);
+  uint32_t mask = 0x1UL<<position;
+
+  write_shadow(TMC_REG_GCONF, &_gconf, TMC_SHADOW_GCONF, ( _gconf&~mask ) | ( (uint32_t(value)<<position)&mask ));
 
   return _status;
 }
@@ -142,7 +165,9 @@ uint8_t Trinamic_TMC2130::set_GCONF(uint8_t position, uint8_t value)
 // set single bits or values in the chopconf register (constraining masks are applied if necessary)
 uint8_t Trinamic_TMC2130::set_CHOPCONF(uint8_t position, uint8_t value)
 {
-  alter_REG(TMC_REG_CHOPCONF, uint32_t(value)<<position, TMC_CHOPCONF_MASKS[position]<<position);
+  uint32_t mask = TMC_CHOPCONF_MASKS[position]<<position;
+
+  write_shadow(TMC_REG_CHOPCONF, &_chopconf, TMC_SHADOW_CHOPCONF, ( _chopconf&~mask ) | ( (uint32_t(value)<<position)&mask ));
 
   return _status;
 }
@@ -294,7 +319,7 @@ uint8_t Trinamic_TMC2130::set_IHOLD_IRUN(uint8_t ihold, uint8_t irun, uint8_t ih
   data |= (( uint32_t(iholddelay)&TMC_IHOLDDELAY_MASK )<<TMC_IHOLDDELAY );
 
   // writing data
-  write_REG(TMC_REG_IHOLD_IRUN, data);
+  write_shadow(TMC_REG_IHOLD_IRUN, &_ihold_irun, TMC_SHADOW_IHOLD_IRUN, data);
 
   return _status;
 }
@@ -710,9 +735,7 @@ uint8_t Trinamic_TMC2130::set_toff(uint8_t value)
 // alter coolconf
 uint8_t Trinamic_TMC2130::alter_COOLCONF(uint32_t data, uint32_t mask)
 {
-  _coolconf = ( _coolconf & ~mask ) | ( data & mask );
-
-  write_REG( TMC_REG_COOLCONF, _coolconf );
+  write_shadow( TMC_REG_COOLCONF, &_coolconf, TMC_SHADOW_COOLCONF, ( _coolconf & ~mask ) | ( data & mask ) );
 
   return _status;
 }
@@ -799,9 +822,7 @@ uint8_t Trinamic_TMC2130::set_DCCTRL(uint16_t dc_time, uint16_t dc_sg)
 // alter pwmconf
 uint8_t Trinamic_TMC2130::alter_PWMCONF(uint32_t data, uint32_t mask)
 {
-  _pwmconf = ( _pwmconf & ~mask ) | ( data & mask );
-
-  write_REG( TMC_REG_PWMCONF, _pwmconf );
+  write_shadow( TMC_REG_PWMCONF, &_pwmconf, TMC_SHADOW_PWMCONF, ( _pwmconf & ~mask ) | ( data & mask ) );
 
   return _status;
 }
@@ -15,7 +15,7 @@ v0.1 - it works
 #define TRINAMIC_TMC2130_H
 
 #if ARDUINO >= 100
-#include "Arduino.h"
+#include <Arduino.h>
 #else
 #include "WProgram.h"
 #endif
@@ -24,6 +24,13 @@ v0.1 - it works
 
 #include "Trinamic_TMC2130_registers.h"
 
+// registers kept in a RAM shadow, written only when their value changes
+#define TMC_SHADOW_GCONF      (0x01)
+#define TMC_SHADOW_IHOLD_IRUN (0x02)
+#define TMC_SHADOW_CHOPCONF   (0x04)
+#define TMC_SHADOW_COOLCONF   (0x08)
+#define TMC_SHADOW_PWMCONF    (0x10)
+
 class Trinamic_TMC2130{
 public:
   Trinamic_TMC2130(uint8_t csPin);
@@ -34,6 +41,7 @@ public:
   uint8_t read_REG( uint8_t address , uint32_t *data );
   uint8_t write_REG( uint8_t address, uint32_t data );
   uint8_t alter_REG(uint8_t address, uint32_t data, uint32_t mask);
+  uint8_t write_shadow(uint8_t address, uint32_t *shadow, uint8_t flag, uint32_t data);
 
   uint8_t set_GCONF(uint8_t bit, uint8_t value);
   uint8_t set_I_scale_analog(uint8_t value);
@@ -126,8 +134,12 @@ public:
   boolean isStandstill();
 
 private:
+  uint32_t _gconf;
+  uint32_t _ihold_irun;
+  uint32_t _chopconf;
   uint32_t _coolconf;
   uint32_t _pwmconf;
+  uint8_t _shadow_valid; // TMC_SHADOW_* flags of shadows matching the chip
   uint8_t _csPin;
   uint8_t _status;
 };
@@ -15,7 +15,7 @@ v0.1 - it works
 #define TRINAMIC_TMC2130_REGISTERS_H
 
 #if ARDUINO >= 100
-#include "Arduino.h"
+#include <Arduino.h>
 #else
 #include "WProgram.h"
 #endif
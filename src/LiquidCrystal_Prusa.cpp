@@ -1,6 +1,7 @@
 #include "LiquidCrystal_Prusa.h"
 #include "Arduino.h"
 #include "i18n.h"
+#include "fastio.h"
 
 // When the display powers up, it is configured as follows:
 //
@@ -28,10 +29,10 @@
 
 LiquidCrystal_Prusa::LiquidCrystal_Prusa() : SimplePrint()
 {
-	pinMode(LCD_PINS_RS, OUTPUT);
+	FAST_OUTPUT(LCD_PINS_RS);
 	pinMode(LCD_PWM_PIN, OUTPUT);
 	digitalWrite(LCD_PWM_PIN, HIGH);
-	pinMode(LCD_PINS_ENABLE, OUTPUT);
+	FAST_OUTPUT(LCD_PINS_ENABLE);
 	begin();
 }
 
@@ -41,8 +42,12 @@ void LiquidCrystal_Prusa::begin() {
 	// before sending commands. Arduino can turn on way befer 4.5V so we'll wait 50
 	delayMicroseconds(50000);
 	// Now we pull both RS and R/W low to begin commands
-	digitalWrite(LCD_PINS_RS, LOW);
-	digitalWrite(LCD_PINS_ENABLE, LOW);
+	FAST_WRITE(LCD_PINS_RS, LOW);
+	FAST_WRITE(LCD_PINS_ENABLE, LOW);
+	FAST_OUTPUT(LCD_PINS_D4);
+	FAST_OUTPUT(LCD_PINS_D5);
+	FAST_OUTPUT(LCD_PINS_D6);
+	FAST_OUTPUT(LCD_PINS_D7);
 
 	// 4 bit mode
 	// this is according to the hitachi HD44780 datasheet
@@ -61,6 +66,7 @@ void LiquidCrystal_Prusa::begin() {
 
 	// finally, set to 4-bit interface
 	write4bits(0x02);
+	delayMicroseconds(LCD_SETTLE_US);
 
 	// finally, set # lines, font size, etc.
 	command(LCD_FUNCTIONSET | DISPLAY_FUNCTION);
@@ -70,8 +76,17 @@ void LiquidCrystal_Prusa::begin() {
 	display();
 	delayMicroseconds(60);
 	// clear it off
-	clear();
+	command(LCD_CLEARDISPLAY);
 	delayMicroseconds(3000);
+	memset(_shadow, ' ', sizeof(_shadow));
+	memset(_dirty, 0, sizeof(_dirty));
+	_dirty_count = 0;
+	_cursor = 0;
+	_flush_cell = 0;
+	_address = 0;
+	_us_last = micros();
+	_sent_bytes = 0;
+	_frame_bytes = 0;
 	// Initialize to default text direction (for romance languages)
 	_displaymode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
 	// set the entry mode
@@ -83,18 +98,22 @@ void LiquidCrystal_Prusa::begin() {
 void LiquidCrystal_Prusa::reinit() {
 	// we start in 8bit mode, try to set 4 bit mode
 	write4bits(0x03);
+	delayMicroseconds(LCD_SETTLE_US);
 	//delayMicroseconds(50); // wait min 4.1ms
 
 	// second try
 	write4bits(0x03);
+	delayMicroseconds(LCD_SETTLE_US);
 	//delayMicroseconds(50); // wait min 4.1ms
 
 	// third go!
 	write4bits(0x03);
+	delayMicroseconds(LCD_SETTLE_US);
 	//delayMicroseconds(50);
 
 	// finally, set to 4-bit interface
 	write4bits(0x02);
+	delayMicroseconds(LCD_SETTLE_US);
 
 	// finally, set # lines, font size, etc.
 	command(LCD_FUNCTIONSET | DISPLAY_FUNCTION);
@@ -106,24 +125,34 @@ void LiquidCrystal_Prusa::reinit() {
 
 	command(LCD_CURSORSHIFT | LCD_ENTRYSHIFTDECREMENT);
 	command(LCD_CURSORSHIFT | LCD_ENTRYSHIFTDECREMENT);
-	write(' ');
-	write(' ');
+	send(' ', HIGH);
+	send(' ', HIGH);
+	_address = 0xFF;
+	// display content is unknown, send everything again
+	memset(_dirty, 0xFF, sizeof(_dirty));
+	_dirty_count = sizeof(_shadow);
 }
 
 
 /********** high level commands, for the user! */
 void LiquidCrystal_Prusa::clear() {
-	command(LCD_CLEARDISPLAY);	// clear display, set cursor position to zero
-	delayMicroseconds(1600);	// this command takes a long time
+	// only the cells which are not blank yet are sent by flush()
+	_cursor = 0;
+	while (_cursor < sizeof(_shadow)) {
+		write(' ');
+	}
+	_cursor = 0;
 }
 
 void LiquidCrystal_Prusa::home() {
 	command(LCD_RETURNHOME);	// set cursor position to zero
 	delayMicroseconds(1600);	// this command takes a long time!
+	_cursor = 0;
+	_address = 0;
 }
 
 void LiquidCrystal_Prusa::setCursor(uint8_t col, uint8_t row) {
-	command(LCD_SETDDRAMADDR | (col + _row_offsets[row]));
+	_cursor = row * DISPLAY_CHARS + col;
 }
 
 // Turn the display on/off (quickly)
@@ -194,8 +223,9 @@ void LiquidCrystal_Prusa::createChar(uint8_t location, const uint8_t* charmap) {
 	location &= 0x7; // we only have 8 locations 0-7
 	command(LCD_SETCGRAMADDR | (location << 3));
 	for (uint8_t i = 0; i < 8; i++) {
-		write(pgm_read_byte(charmap++));
+		send(pgm_read_byte(charmap++), HIGH);
 	}
+	_address = 0xFF;
 }
 
 void LiquidCrystal_Prusa::setBrightness(uint8_t brightness) {
@@ -207,9 +237,9 @@ void LiquidCrystal_Prusa::print(uint8_t number, uint8_t col, uint8_t row, uint8_
 	SimplePrint::print(number, denom, filler);
 }
 
-void LiquidCrystal_Prusa::print(float number, uint8_t col, uint8_t row) {
+void LiquidCrystal_Prusa::print(int16_t deci, uint8_t col, uint8_t row) {
 	setCursor(col, row);
-	SimplePrint::print(number);
+	SimplePrint::print(deci);
 }
 
 void LiquidCrystal_Prusa::printTime(uint16_t time, uint8_t col, uint8_t row) {
@@ -241,33 +271,91 @@ inline void LiquidCrystal_Prusa::command(uint8_t value) {
 }
 
 inline void LiquidCrystal_Prusa::write(uint8_t value) {
-	send(value, HIGH);
+	if (_cursor < sizeof(_shadow)) {
+		if (_shadow[_cursor] != value) {
+			_shadow[_cursor] = value;
+			uint8_t mask = 1 << (_cursor & 7);
+			if (!(_dirty[_cursor >> 3] & mask)) {
+				_dirty[_cursor >> 3] |= mask;
+				++_dirty_count;
+			}
+		}
+		++_cursor;
+	}
+}
+
+//! @brief Send one byte of the changed cells
+//!
+//! Never waits, returns when the previous byte has not settled yet. Changed cells
+//! are sent in display order, the address is set only where the display address
+//! counter does not already point to the next changed cell.
+void LiquidCrystal_Prusa::flush() {
+	if (!_dirty_count || micros() - _us_last < LCD_SETTLE_US) {
+		return;
+	}
+	uint8_t cell = _flush_cell;
+	while (!(_dirty[cell >> 3] & (1 << (cell & 7)))) {
+		if (++cell == sizeof(_shadow)) {
+			cell = 0;
+		}
+	}
+	uint8_t row = cell / DISPLAY_CHARS;
+	uint8_t address = _row_offsets[row] + cell - row * DISPLAY_CHARS;
+	if (address != _address) {
+		transmit(LCD_SETDDRAMADDR | address, LOW);
+		_address = address;
+	} else {
+		transmit(_shadow[cell], HIGH);
+		_dirty[cell >> 3] &= ~(1 << (cell & 7));
+		--_dirty_count;
+		++_address;
+		_flush_cell = cell < sizeof(_shadow) - 1 ? cell + 1 : 0;
+	}
+	_us_last = micros();
+	++_sent_bytes;
+	if (!_dirty_count) {
+		_frame_bytes = _sent_bytes;
+		_sent_bytes = 0;
+	}
+}
+
+uint16_t LiquidCrystal_Prusa::get_frame_bytes() {
+	return _frame_bytes;
+}
+
+bool LiquidCrystal_Prusa::is_flushed() {
+	return !_dirty_count;
 }
 
 
 /************ low level data pushing commands **********/
 
-// write either command or data, with automatic 4/8-bit selection
+// write either command or data and wait until it settles
 void LiquidCrystal_Prusa::send(uint8_t value, uint8_t mode) {
-	digitalWrite(LCD_PINS_RS, mode);
+	transmit(value, mode);
+	delayMicroseconds(LCD_SETTLE_US);
+}
+
+// write either command or data, caller is responsible for settle time
+void LiquidCrystal_Prusa::transmit(uint8_t value, uint8_t mode) {
+	FAST_WRITE(LCD_PINS_RS, mode);
 	write4bits(value>>4);
 	write4bits(value);
 }
 
+// enable is kept low between pulses, data pins are already set
 void LiquidCrystal_Prusa::pulseEnable(void) {
-	digitalWrite(LCD_PINS_ENABLE, LOW);
-	delayMicroseconds(1);
-	digitalWrite(LCD_PINS_ENABLE, HIGH);
+	FAST_WRITE(LCD_PINS_ENABLE, HIGH);
 	delayMicroseconds(1);		// enable pulse must be >450ns
-	digitalWrite(LCD_PINS_ENABLE, LOW);
-	delayMicroseconds(50);		// commands need > 37us to settle
+	FAST_WRITE(LCD_PINS_ENABLE, LOW);
 }
 
+// data pins direction is set once in begin()
 void LiquidCrystal_Prusa::write4bits(uint8_t value) {
-	for (uint8_t i = 0; i < 4; i++) {
-		pinMode(_data_pins[i], OUTPUT);
-		digitalWrite(_data_pins[i], (value >> i) & 0x01);
-	}
+	FAST_WRITE(LCD_PINS_D4, value & 0x01);
+	FAST_WRITE(LCD_PINS_D5, value & 0x02);
+	FAST_WRITE(LCD_PINS_D6, value & 0x04);
+	FAST_WRITE(LCD_PINS_D7, value & 0x08);
 	pulseEnable();
 }
 
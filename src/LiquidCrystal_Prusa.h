@@ -43,6 +43,9 @@
 #define LCD_5x8DOTS 0x00
 #define DISPLAY_FUNCTION LCD_4BITMODE | LCD_2LINE | LCD_5x8DOTS
 
+// commands need > 37us to settle
+#define LCD_SETTLE_US 50
+
 class LiquidCrystal_Prusa : public SimplePrint {
 public:
 	using SimplePrint::print;
@@ -74,21 +77,37 @@ public:
 	static void setBrightness(uint8_t);
 
 	void print(uint8_t number, uint8_t col, uint8_t row, uint8_t denom = 100, unsigned char filler = ' ');
-	void print(float number, uint8_t col, uint8_t row);
+	void print(int16_t deci, uint8_t col, uint8_t row);
 	void printTime(uint16_t time, uint8_t col, uint8_t row);
 	void print(const char* str, uint8_t col, uint8_t row);
 	void print_P(const char* str, uint8_t col, uint8_t row);
 	void clearLine(uint8_t row);
 
+	void flush();
+	uint16_t get_frame_bytes();
+	bool is_flushed();
+
 private:
 	void send(uint8_t, uint8_t);
+	void transmit(uint8_t, uint8_t);
 	void write4bits(uint8_t);
 	void pulseEnable();
 
 	uint8_t _displaycontrol;
 	uint8_t _displaymode;
 
-	uint8_t _data_pins[4] = { LCD_PINS_D4, LCD_PINS_D5, LCD_PINS_D6, LCD_PINS_D7 };
+	// shadow of the display content, write() and clear() only touch this,
+	// flush() sends the changed cells one byte per call
+	uint8_t _shadow[DISPLAY_CHARS * DISPLAY_LINES];
+	uint8_t _dirty[(DISPLAY_CHARS * DISPLAY_LINES + 7) / 8];
+	uint8_t _dirty_count;
+	uint8_t _cursor;		// shadow index of the next write()
+	uint8_t _flush_cell;	// shadow index where flush() continues
+	uint8_t _address;		// display DDRAM address counter, 0xFF when unknown
+	unsigned long _us_last;	// last byte sent by flush()
+	uint16_t _sent_bytes;	// bytes sent since the display was last in sync
+	uint16_t _frame_bytes;	// bytes of the last complete frame, kept while the next one is sent
+
 	uint8_t _row_offsets[4] = { 0x00, 0x40, 0x14, 0x54 };
 };
 
@@ -5,9 +5,13 @@
 #define EEPROM_OFFSET	128
 #define MAGIC_SIZE		6
 #define EEPROM_BASE		E2END + 1 - EEPROM_OFFSET
-static_assert(sizeof(eeprom_v2_t) <= EEPROM_OFFSET, "eeprom_t doesn't fit in it's reserved space in the memory.");
+#define CONFIG_BYTES	(MAGIC_SIZE + sizeof(eeprom_v4_t))
+static_assert(sizeof(eeprom_v4_t) <= EEPROM_OFFSET, "eeprom_t doesn't fit in it's reserved space in the memory.");
+static_assert(CONFIG_BYTES <= UINT8_MAX, "dirty byte index is 8 bits");
 
-const char config_magic[MAGIC_SIZE] PROGMEM = "CW1v2";
+const char config_magic[MAGIC_SIZE] PROGMEM = "CW1v4";
+const char legacy_magic3[MAGIC_SIZE] PROGMEM = "CW1v3";
+const char legacy_magic2[MAGIC_SIZE] PROGMEM = "CW1v2";
 const char legacy_magic1[MAGIC_SIZE] PROGMEM = "CURWA";
 
 //! @brief configuration
@@ -16,7 +20,7 @@ const char legacy_magic1[MAGIC_SIZE] PROGMEM = "CURWA";
 //! it can be overridden by user and stored to
 //! and restored from permanent storage.
 
-eeprom_v2_t config = {
+eeprom_v4_t config = {
 	10,			// washing_speed
 	1,			// curing_speed
 	4,			// washing_run_time
@@ -44,13 +48,90 @@ eeprom_v2_t config = {
 		{60, 70},	// fans_curing_speed
 	#endif
 	100,		// lcd_brightness
+
+	#ifdef CW1S
+		HEATER_PID_KP,	// heater_pid_kp
+		HEATER_PID_KI,	// heater_pid_ki
+		HEATER_PID_KD,	// heater_pid_kd
+	#else
+		0,			// heater_pid_kp (on/off heater)
+		0,			// heater_pid_ki
+		0,			// heater_pid_kd
+	#endif
+
+	0,			// fans_rpm_control
+	{{0}, {0}},	// fans_curve (not learned)
 };
 
+// Bytes of magic and config changed since they were written. The EEPROM
+// ready interrupt writes them one by one once there was no change for
+// CONFIG_WRITE_DELAY, bytes equal to the EEPROM content are skipped.
+static uint8_t dirty[(CONFIG_BYTES + 7) / 8];
+static uint8_t dirty_next;			// byte index the interrupt continues from
+static bool write_pending;
+static uint16_t write_ms;			// last change
+static bool magic_current = false;	// EEPROM holds the current layout
+
+static uint8_t config_byte(uint8_t i) {
+	if (i < MAGIC_SIZE)
+		return pgm_read_byte(&config_magic[i]);
+	return reinterpret_cast<uint8_t*>(&config)[i - MAGIC_SIZE];
+}
+
+static void mark_dirty(uint8_t first, uint8_t count) {
+	cli();
+	// writing restarts after the settle delay
+	EECR &= ~_BV(EERIE);
+	for (; count; --count, ++first)
+		dirty[first >> 3] |= 1 << (first & 7);
+	dirty_next = 0;
+	sei();
+	write_pending = true;
+	write_ms = millis();
+}
+
 void write_config() {
-	char magic[MAGIC_SIZE];
-	strncpy_P(magic, config_magic, MAGIC_SIZE);
-	EEPROM.put(EEPROM_BASE, reinterpret_cast<uint8_t*>(magic), MAGIC_SIZE);
-	EEPROM.put(EEPROM_BASE + MAGIC_SIZE, reinterpret_cast<uint8_t*>(&config), sizeof(config));
+	mark_dirty(0, CONFIG_BYTES);
+	magic_current = true;
+}
+
+void write_config(const void* field, uint8_t size) {
+	uintptr_t offset = (uintptr_t)field - (uintptr_t)&config;
+	if (offset + size > sizeof(config))
+		return;
+	if (!magic_current) {
+		// other fields of an older layout are written with it
+		write_config();
+	} else {
+		mark_dirty(MAGIC_SIZE + offset, size);
+	}
+}
+
+void write_config_task() {
+	if (write_pending && (uint16_t)((uint16_t)millis() - write_ms) >= CONFIG_WRITE_DELAY) {
+		write_pending = false;
+		cli();
+		EECR |= _BV(EERIE);
+		sei();
+	}
+}
+
+// EEPROM ready interrupt
+void write_config_next() {
+	while (dirty_next < CONFIG_BYTES) {
+		uint8_t i = dirty_next++;
+		uint8_t mask = 1 << (i & 7);
+		if (!(dirty[i >> 3] & mask))
+			continue;
+		dirty[i >> 3] &= ~mask;
+		uint8_t value = config_byte(i);
+		uint8_t* address = reinterpret_cast<uint8_t*>(EEPROM_BASE + i);
+		if (eeprom_read_byte(address) != value) {
+			eeprom_write_byte(address, value);
+			return;
+		}
+	}
+	EECR &= ~_BV(EERIE);
 }
 
 /*! \brief This function loads user-defined values from eeprom.
@@ -58,15 +139,31 @@ void write_config() {
  *	It loads different amount of variables, depending on the magic variable from eeprom.
  *	If magic is not set in the eeprom, variables keep their default values.
  *	If magic from eeprom is equal to lagacy magic, it loads only variables customizable in older firmware and keeps new variables default.
+ *	Heater PID gains keep their defaults until autotuned when older config is loaded,
+ *	fans RPM control stays off until the fans are calibrated.
  *	If magic from eeprom is equal to config_magic, it loads all variables including those added in new firmware.
  *	It won't load undefined (new) variables after flashing new firmware.
  */
 void read_config() {
+	// the interrupt shares EEPROM registers, it continues with the next task run
+	cli();
+	if (EECR & _BV(EERIE))
+		write_pending = true;
+	EECR &= ~_BV(EERIE);
+	dirty_next = 0;
+	sei();
+	eeprom_busy_wait();
 	char test_magic[MAGIC_SIZE];
 	EEPROM.get(EEPROM_BASE, reinterpret_cast<uint8_t*>(test_magic), MAGIC_SIZE);
 	if (!strncmp_P(test_magic, config_magic, MAGIC_SIZE)) {
 		// latest magic
 		EEPROM.get(EEPROM_BASE + MAGIC_SIZE, reinterpret_cast<uint8_t*>(&config), sizeof(config));
+		magic_current = true;
+	} else if (!strncmp_P(test_magic, legacy_magic3, MAGIC_SIZE)) {
+		EEPROM.get(EEPROM_BASE + MAGIC_SIZE, reinterpret_cast<uint8_t*>(&config), sizeof(eeprom_v3_t));
+	} else if (!strncmp_P(test_magic, legacy_magic2, MAGIC_SIZE)) {
+		// previous magic
+		EEPROM.get(EEPROM_BASE + MAGIC_SIZE, reinterpret_cast<uint8_t*>(&config), sizeof(eeprom_v2_t));
 	} else if (!strncmp_P(test_magic, legacy_magic1, MAGIC_SIZE)) {
 		// legacy magic
 		uint8_t tmp = config.resin_target_temp;	// remember default
@@ -74,8 +171,8 @@ void read_config() {
 		if (config.SI_unit_system) {
 			config.resin_target_temp = tmp;
 		} else {
-			config.target_temp = round(celsius2fahrenheit(config.target_temp));
-			config.resin_target_temp = round(celsius2fahrenheit(tmp));
+			config.target_temp = (celsius2fahrenheit(config.target_temp * 10) + 5) / 10;
+			config.resin_target_temp = (celsius2fahrenheit(tmp * 10) + 5) / 10;
 		}
 	}
 	#ifdef CW1S
@@ -38,13 +38,28 @@
 #define LED_DELAY			2000
 #define LONG_PRESS_TIME		1000
 #define	P					10	// 0.5
-#define I					0.001
+#define I_INV				1000	// 1 / I, I = 0.001
 #define MIN_TARGET_TEMP_C	20
 #ifdef CW1S
   #define MAX_TARGET_TEMP_C	60
   #define HEATING_ON_FAN1_DUTY  100
   #define CHAMBER_TEMP_THR_FAN1_ON	35
   #define CHAMBER_TEMP_THR_FAN1_DUTY	40
+  // chamber heater PID, gains are 1/256 of heater duty (0-1000) per 0.1 celsius,
+  // defaults until autotuned (stored in config)
+  #define HEATER_MIN_SWITCH	20		// timer0 ticks (1.024 ms), shortest heater on/off time
+  #define HEATER_PID_PERIOD	1000	// milliseconds
+  #define HEATER_PID_KP		10240	// full power 2.5 celsius below target
+  #define HEATER_PID_KI		320		// per period
+  #define HEATER_PID_KD		51200	// per period, on measurement
+  #define HEATER_PID_D_FILTER	2		// measurement for derivative follows 1/4 per period
+  #define WARMUP_TEMP_TOLERANCE	1	// 0.1 degree, PID holds the reading within one step of target
+  #define HEATER_PID_GAIN_MAX	500000	// larger tuned gains are refused
+  #define HEATER_PID_ERROR_MAX	1000	// 0.1 celsius, with HEATER_PID_GAIN_MAX keeps PID terms in int32
+  // relay autotune around target temperature
+  #define HEATER_AUTOTUNE_CYCLES	5
+  #define HEATER_AUTOTUNE_HYST		2		// 0.1 celsius
+  #define HEATER_AUTOTUNE_TIME		90		// minutes
 #else
   #define MAX_TARGET_TEMP_C	40
 #endif
@@ -60,26 +75,43 @@
 #define MIN_LED_INTENSITY	1		// 0-100 %
 #define MIN_LCD_BRIGHTNESS	5		// 0-100 %
 #define MIN_FAN_SPEED		30		// 0-100 %
-#define FAN_CHECK_PERIOD	500		// microseconds
+#define FAN_CHECK_PERIOD	100		// milliseconds
+#define FAN_TACHO_PERIODS	5		// median of last tacho periods
+#define FAN_TACHO_SHIFT		4		// tacho period unit 16 us
+#define FAN_TACHO_TIMEOUT	500		// milliseconds without tacho edge is 0 rpm
+// fans RPM control, duty setting is a share of FAN_RPM_NOMINAL
+#define FAN_RPM_NOMINAL		5400	// tacho pulses per minute at 100 %, reachable by a healthy fan
+#define FAN_RPM_KI			3		// 1/4096 % per (pulse per minute) every FAN_CHECK_PERIOD
+#define FAN_RPM_LIMIT		20		// % of correction on top of the learned curve
+#define FAN_DEGRADED_TIME	100		// FAN_CHECK_PERIODs below 7/8 of target at full duty
+#define FAN_CURVE_POINTS	8		// learned from MIN_FAN_SPEED by FAN_CURVE_STEP
+#define FAN_CURVE_STEP		10		// %
+#define FAN_CURVE_SETTLE	3		// seconds per learned point
 #define SWITCH_TEST_COUNT	10
 #define ROTATION_TEST_TIME	3		// minutes
-#define FANS_TEST_TIME		2		// minutes
+#define FANS_TEST_TIME		1		// minutes
 #define UVLED_TEST_TIME		10		// minutes
-#define UVLED_TEST_GAIN		10.0	// celsius
-#define UVLED_MAX_TEMP		70.0	// celsius
+#define UVLED_TEST_GAIN		10		// celsius
+#define UVLED_MAX_TEMP		70		// celsius
 #define HEATER_TEST_TIME	10		// minutes
-#define HEATER_TEST_GAIN	5.0		// celsius
+#define HEATER_TEST_GAIN	5		// celsius
 #define HEATER_CHECK_DELAY	2000	// microseconds
 #define SN_LENGTH			15
 #define MAX_MENU_DEPTH		5
 #define MENU_REDRAW_US		1000
-#define ADC_OVRSAMPL		4
+#define ADC_OVRSAMPL		4		// samples averaged per thermistor (ring buffer length)
+#define ADC_SETTLE_SAMPLES	4		// conversions dropped after ANALOG_SWITCH_A toggles, 1.024 ms each
+#define MCP_POLL_PERIOD		50		// milliseconds, MCP inputs read even without INTA change
+#define MCP_IDLE_POLL_PERIOD	10	// milliseconds, MCP inputs read while sleeping (no INTA)
+#define CONFIG_WRITE_DELAY	2000	// milliseconds without config change before it is written
 // motor speeds (smaller is faster)
 #define FAST_SPEED_START	200
 #define MIN_FAST_SPEED		70
 #define MAX_FAST_SPEED		16
 #define MIN_SLOW_SPEED		220
 #define MAX_SLOW_SPEED		25
+#define STEPPER_TIMER_HZ	250000	// timer 3 ticks per second (prescaler 64), one step per period
+#define FAST_SPEED_ACCEL	4000	// steps/s^2, washing motor ramp from FAST_SPEED_START
 
 #define MCP_A0	1	// pin 21
 #define MCP_A1	2	// pin 22
@@ -97,5 +129,6 @@
 #define MCP_B5	14	// pin 6 - not connected
 #define MCP_B6	15	// pin 7 - not connected
 #define MCP_B7	16	// pin 8 - not connected
+#define MCP_MASK(pin)	(1 << ((pin) - 1))	// pin bit in MCP word (GPIOB:GPIOA)
 
 #include "pins_board_4.h"
@@ -0,0 +1,66 @@
+#include <Arduino.h>
+
+#include "events.h"
+
+namespace Events {
+
+	static_assert(!(EVENT_QUEUE_SIZE & (EVENT_QUEUE_SIZE - 1)), "event queue size is not a power of two");
+	static_assert(EVENT_QUEUE_SIZE <= 128, "event queue index is 8 bits");
+	static_assert(EVENT_QUEUE_RESERVED < EVENT_QUEUE_SIZE - 1, "no room left for encoder");
+
+	stats_t stats;
+
+	static event_t queue[EVENT_QUEUE_SIZE];
+	static volatile uint8_t head = 0;	// written by producer only
+	static volatile uint8_t tail = 0;	// written by consumer only
+
+	// from ISR or with interrupts disabled
+	bool push(uint8_t type) {
+		uint8_t h = head;
+		uint8_t next = (h + 1) & (EVENT_QUEUE_SIZE - 1);
+		if (next == tail) {
+			if (stats.dropped < UINT8_MAX)
+				++stats.dropped;
+			return false;
+		}
+		queue[h].type = type;
+		queue[h].us = micros();
+		// entry has to be complete before the consumer sees it
+		__asm__ __volatile__("" ::: "memory");
+		head = next;
+		return true;
+	}
+
+	bool pop(event_t& event) {
+		return pop_if(0, event);
+	}
+
+	//! pops only event of type, any event for 0
+	bool pop_if(uint8_t type, event_t& event) {
+		uint8_t t = tail;
+		if (t == head || (type && queue[t].type != type))
+			return false;
+		event = queue[t];
+		__asm__ __volatile__("" ::: "memory");
+		tail = (t + 1) & (EVENT_QUEUE_SIZE - 1);
+		unsigned long wait = micros() - event.us;
+		++stats.events;
+		stats.wait_us += wait;
+		if (wait > stats.max_wait_us)
+			stats.max_wait_us = wait;
+		return true;
+	}
+
+	bool empty() {
+		return tail == head;
+	}
+
+	bool full() {
+		return ((head + 1) & (EVENT_QUEUE_SIZE - 1)) == tail;
+	}
+
+	uint8_t count() {
+		return (head - tail) & (EVENT_QUEUE_SIZE - 1);
+	}
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+// Timestamped input events (EVENT_* in hardware.h) in a single producer,
+// single consumer ring. Encoder detents are pushed from the timer 0 ISR,
+// switches and button from Hardware::loop() with interrupts disabled, so the
+// ring sees one producer. Hardware::loop() pops one event per main loop pass.
+// A full ring drops the new event: the encoder keeps its detents meanwhile and
+// leaves EVENT_QUEUE_RESERVED entries free, switches and button retry.
+// With MCP_INTA_PIN the expander captures the inputs at the first change
+// (INTCAP), so a cover or tank flipped and flipped back before the next read
+// still gives both events. Without it the inputs are read once per loop pass
+// and such a pair between two reads is lost, this is not solved there.
+
+#include <stdint.h>
+
+#define EVENT_QUEUE_SIZE	16	// power of two
+#define EVENT_QUEUE_RESERVED	4	// entries the encoder leaves to switches and button
+
+namespace Events {
+
+	struct event_t {
+		uint8_t type;
+		unsigned long us;	// micros() when detected
+	};
+
+	struct stats_t {
+		uint16_t events;
+		uint8_t dropped;
+		unsigned long max_wait_us;	// detected to popped
+		unsigned long wait_us;	// sum, for average
+	};
+
+	extern stats_t stats;
+
+	bool push(uint8_t type);
+	bool pop(event_t& event);
+	bool pop_if(uint8_t type, event_t& event);
+	bool empty();
+	bool full();
+	uint8_t count();
+
+}
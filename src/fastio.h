@@ -0,0 +1,112 @@
+#pragma once
+
+// Compile-time pin mapping of the ATmega32U4 (Arduino Leonardo numbering used
+// in pins_board_*.h). Pin access compiles to single sbi/cbi/sbis instructions
+// instead of digitalWrite/digitalRead table lookups.
+// Pin has to be a compile-time constant and must not have PWM running,
+// unlike digitalWrite these macros do not turn PWM off.
+
+#include <avr/io.h>
+
+#define DIO0_PORT	D
+#define DIO0_BIT	2
+#define DIO1_PORT	D
+#define DIO1_BIT	3
+#define DIO2_PORT	D
+#define DIO2_BIT	1
+#define DIO3_PORT	D
+#define DIO3_BIT	0
+#define DIO4_PORT	D
+#define DIO4_BIT	4
+#define DIO5_PORT	C
+#define DIO5_BIT	6
+#define DIO6_PORT	D
+#define DIO6_BIT	7
+#define DIO7_PORT	E
+#define DIO7_BIT	6
+#define DIO8_PORT	B
+#define DIO8_BIT	4
+#define DIO9_PORT	B
+#define DIO9_BIT	5
+#define DIO10_PORT	B
+#define DIO10_BIT	6
+#define DIO11_PORT	B
+#define DIO11_BIT	7
+#define DIO12_PORT	D
+#define DIO12_BIT	6
+#define DIO13_PORT	C
+#define DIO13_BIT	7
+#define DIO14_PORT	B
+#define DIO14_BIT	3
+#define DIO15_PORT	B
+#define DIO15_BIT	1
+#define DIO16_PORT	B
+#define DIO16_BIT	2
+#define DIO17_PORT	B
+#define DIO17_BIT	0
+#define DIO18_PORT	F
+#define DIO18_BIT	7
+#define DIO19_PORT	F
+#define DIO19_BIT	6
+#define DIO20_PORT	F
+#define DIO20_BIT	5
+#define DIO21_PORT	F
+#define DIO21_BIT	4
+#define DIO22_PORT	F
+#define DIO22_BIT	1
+#define DIO23_PORT	F
+#define DIO23_BIT	0
+#define DIO24_PORT	D
+#define DIO24_BIT	4
+#define DIO25_PORT	D
+#define DIO25_BIT	7
+#define DIO26_PORT	B
+#define DIO26_BIT	4
+#define DIO27_PORT	B
+#define DIO27_BIT	5
+#define DIO28_PORT	B
+#define DIO28_BIT	6
+#define DIO29_PORT	D
+#define DIO29_BIT	6
+#define DIO30_PORT	D
+#define DIO30_BIT	5
+#define DIO31_PORT	E
+#define DIO31_BIT	2
+
+// analog pin names (pins_board_3.h)
+#define DIOA0_PORT	DIO18_PORT
+#define DIOA0_BIT	DIO18_BIT
+#define DIOA1_PORT	DIO19_PORT
+#define DIOA1_BIT	DIO19_BIT
+#define DIOA2_PORT	DIO20_PORT
+#define DIOA2_BIT	DIO20_BIT
+#define DIOA3_PORT	DIO21_PORT
+#define DIOA3_BIT	DIO21_BIT
+#define DIOA4_PORT	DIO22_PORT
+#define DIOA4_BIT	DIO22_BIT
+#define DIOA5_PORT	DIO23_PORT
+#define DIOA5_BIT	DIO23_BIT
+
+#define _FASTIO_CAT(a, b)	a##b
+#define _FASTIO_REG(reg, port)	_FASTIO_CAT(reg, port)
+
+// pin argument is macro expanded by the public macros before pasting
+#define _FASTIO_PORT(pin)	_FASTIO_REG(PORT, DIO##pin##_PORT)
+#define _FASTIO_PIN(pin)	_FASTIO_REG(PIN, DIO##pin##_PORT)
+#define _FASTIO_DDR(pin)	_FASTIO_REG(DDR, DIO##pin##_PORT)
+#define _FASTIO_MASK(pin)	_BV(DIO##pin##_BIT)
+
+#define _FAST_WRITE(pin, value) do { \
+		if (value) \
+			_FASTIO_PORT(pin) |= _FASTIO_MASK(pin); \
+		else \
+			_FASTIO_PORT(pin) &= (uint8_t)~_FASTIO_MASK(pin); \
+	} while (0)
+#define _FAST_READ(pin)			((_FASTIO_PIN(pin) & _FASTIO_MASK(pin)) != 0)
+#define _FAST_OUTPUT(pin)		(_FASTIO_DDR(pin) |= _FASTIO_MASK(pin))
+#define _FAST_INPUT(pin)		(_FASTIO_DDR(pin) &= (uint8_t)~_FASTIO_MASK(pin))
+
+#define FAST_WRITE(pin, value)	_FAST_WRITE(pin, value)
+#define FAST_READ(pin)			_FAST_READ(pin)
+#define FAST_OUTPUT(pin)		_FAST_OUTPUT(pin)
+#define FAST_INPUT(pin)			_FAST_INPUT(pin)
@@ -1,65 +1,107 @@
 #include <avr/wdt.h>
 
 #include "hardware.h"
-#include "intpol.h"
+#include "thermistor.h"
 #include "config.h"
+#include "fastio.h"
+#include "scheduler.h"
+#include "events.h"
 
-float celsius2fahrenheit(float celsius) {
-	return 1.8 * celsius + 32;
+int16_t celsius2fahrenheit(int16_t celsius) {
+	return (celsius * 9 + (celsius < 0 ? -2 : 2)) / 5 + 320;
 }
 
-float fahrenheit2celsius(float fahrenheit) {
-	return (fahrenheit - 32) / 1.8;
+int16_t fahrenheit2celsius(int16_t fahrenheit) {
+	int16_t diff = fahrenheit - 320;
+	return (diff * 5 + (diff < 0 ? -4 : 4)) / 9;
 }
 
-const int16_t chamber_temp_table_raw[34] PROGMEM = {
-	25, 29, 34, 40, 46, 54, 64, 75, 88, 105, 124, 146, 173, 204, 241, 282, 330, 382, 439, 500,
-	563, 625, 687, 744, 796, 842, 882, 915, 941, 963, 979, 992, 1001, 1008
-};
+static constexpr thermistor_t chamber_thermistor PROGMEM = thermistor_t(chamber_temp_table_raw);
+static constexpr thermistor_t uvled_thermistor PROGMEM = thermistor_t(uvled_temp_table_raw);
+static_assert(chamber_thermistor.exact() && uvled_thermistor.exact(), "THERM_SLOPE_SHIFT too small");
+static_assert(chamber_thermistor.max_steps() <= THERM_MAX_STEPS && uvled_thermistor.max_steps() <= THERM_MAX_STEPS, "THERM_CELL_SHIFT too big");
+
+// steps to run at timer 3 period p before going to p - 1, constant acceleration:
+// v(p) = STEPPER_TIMER_HZ / (p + 1), steps = (v(p - 1)^2 - v(p)^2) / (2 * FAST_SPEED_ACCEL)
+constexpr uint16_t accel_ramp_steps(uint8_t period) {
+	double v = double(STEPPER_TIMER_HZ) / (period + 1);
+	double v_next = double(STEPPER_TIMER_HZ) / period;
+	uint16_t steps = (v_next * v_next - v * v) / (2.0 * FAST_SPEED_ACCEL) + 0.5;
+	return steps ? steps : 1;
+}
 
-const int16_t uvled_temp_table_raw[34] PROGMEM = {
-	73, 83, 95, 109, 125, 144, 165, 189, 217, 248, 284, 323, 366, 412, 462, 514, 567, 620, 673, 723,
-	770, 813, 851, 885, 913, 937, 957, 973, 986, 995, 1003, 1009, 1013, 1016
+static_assert(MAX_FAST_SPEED <= MIN_FAST_SPEED && MIN_FAST_SPEED < FAST_SPEED_START, "fast speeds out of ramp");
+static_assert((double(STEPPER_TIMER_HZ) / MAX_FAST_SPEED) * (double(STEPPER_TIMER_HZ) / MAX_FAST_SPEED)
+	/ (2.0 * FAST_SPEED_ACCEL) < 65535, "ramp step count overflow");
+
+// indexed by FAST_SPEED_START - period
+struct accel_ramp_t {
+	uint16_t steps[FAST_SPEED_START - MAX_FAST_SPEED];
+	constexpr accel_ramp_t() : steps() {
+		for (uint8_t i = 0; i < FAST_SPEED_START - MAX_FAST_SPEED; ++i)
+			steps[i] = accel_ramp_steps(FAST_SPEED_START - i);
+	}
 };
+static constexpr accel_ramp_t accel_ramp PROGMEM;
 
 
 uint16_t Hardware::fan_rpm[3] = {1, 1, 1};
-volatile uint8_t Hardware::fan_tacho_count[3] = {0, 0, 0};
 volatile uint8_t Hardware::microstep_control(FAST_SPEED_START);
-float Hardware::chamber_temp_celsius(-40.0);
-float Hardware::chamber_temp(-40.0);
-float Hardware::uvled_temp_celsius(-40.0);
-float Hardware::uvled_temp(-40.0);
+int16_t Hardware::chamber_temp_celsius(-400);
+int16_t Hardware::chamber_temp(-400);
+int16_t Hardware::uvled_temp_celsius(-400);
+int16_t Hardware::uvled_temp(-400);
 bool Hardware::heater_error(false);
+uint8_t Hardware::fan_errors(0);
+uint8_t Hardware::control_detents(0);
+uint8_t Hardware::control_steps(0);
 #ifdef CW1S
-	bool Hardware::wanted_heater_pin_state(false);
-	bool Hardware::slow_pwm_on(false);
+	volatile bool Hardware::wanted_heater_pin_state(false);
+	volatile bool Hardware::heater_modulator_on(false);
 #endif
 MCP Hardware::outputchip(0, 8);
 Trinamic_TMC2130 Hardware::myStepper(CS_PIN);
 uint8_t Hardware::lcd_encoder_bits(0);
 volatile int8_t Hardware::rotary_diff(0);
 uint8_t Hardware::target_accel_period(FAST_SPEED_START);
+volatile uint16_t Hardware::accel_steps(0);
 uint8_t Hardware::fan_duty[2] = {0, 0};
 uint8_t Hardware::fan_pwm_pins[2] = {FAN1_PWM_PIN, FAN2_PWM_PIN};
 uint8_t Hardware::fan_enable_pins[2] = {FAN1_PIN, FAN2_PIN};
 uint8_t Hardware::fans_target_temp(0);
-unsigned long Hardware::accel_us_last(0);
-unsigned long Hardware::fans_us_last(0);
-unsigned long Hardware::adc_us_last(0);
+uint8_t Hardware::fan_output[2] = {0, 0};
+int32_t Hardware::fan_rpm_integral[2] = {0, 0};
+uint8_t Hardware::fan_degraded[2] = {0, 0};
+bool Hardware::fans_learning(false);
+volatile unsigned long Hardware::fan_tacho_us_last[3];
+volatile uint16_t Hardware::fan_tacho_period[3][FAN_TACHO_PERIODS];
+volatile uint8_t Hardware::fan_tacho_index[3] = {0, 0, 0};
+volatile uint8_t Hardware::fan_tacho_edges[3] = {0, 0, 0};
 unsigned long Hardware::heater_us_last(0);
 unsigned long Hardware::button_timer(0);
-double Hardware::PI_summ_err(0.0);
+int32_t Hardware::PI_summ_err(0);
 bool Hardware::do_acceleration(false);
 bool Hardware::cover_closed(false);
+uint16_t Hardware::mcp_inputs(0);
+#ifdef MCP_INTA_PIN
+	uint16_t Hardware::mcp_capture(0);
+	bool Hardware::mcp_capture_pending(false);
+#endif
 bool Hardware::tank_inserted(false);
 bool Hardware::button_active(false);
 bool Hardware::long_press_active(false);
-bool Hardware::adc_channel(false);
+volatile bool Hardware::adc_channel(false);
+volatile uint8_t Hardware::adc_settle(ADC_SETTLE_SAMPLES);
+volatile uint8_t Hardware::adc_fresh(0);
+uint8_t Hardware::adc_head(0);
+uint16_t Hardware::adc_samples[2][ADC_OVRSAMPL];
 #ifdef CW1S
 	bool Hardware::heater_on(false);
 	bool Hardware::heater_pin_state(false);
-	uint16_t Hardware::heater_pwm_duty(0);
+	volatile uint16_t Hardware::heater_pwm_duty(0);
+	bool Hardware::heater_pid_on(false);
+	int32_t Hardware::heater_pid_integral(0);
+	int16_t Hardware::heater_pid_temp(0);
 #endif
 
 
@@ -68,8 +110,12 @@ Hardware::Hardware() {
 	outputchip.begin();
 	outputchip.pinMode(0B0000000010010111);
 	outputchip.pullupMode(0B0000000010000011);
-	outputchip.digitalWrite(ANALOG_SWITCH_A, LOW);
-	outputchip.digitalWrite(ANALOG_SWITCH_B, LOW);
+	outputchip.digitalWriteMask(MCP_MASK(ANALOG_SWITCH_A) | MCP_MASK(ANALOG_SWITCH_B), 0);
+	#ifdef MCP_INTA_PIN
+		// any change of cover, tank or button pulls INTA low until GPIO is read
+		pinMode(MCP_INTA_PIN, INPUT_PULLUP);
+		outputchip.interruptEnable(MCP_MASK(BTN_ENC) | MCP_MASK(WASH_DETECT_PIN) | MCP_MASK(COVER_OPEN_PIN));
+	#endif
 
 	// controls
 	pinMode(BTN_EN1, INPUT_PULLUP);
@@ -86,8 +132,11 @@ Hardware::Hardware() {
 	pinMode(FAN1_PWM_PIN, OUTPUT);
 	pinMode(FAN2_PWM_PIN, OUTPUT);
 
-	// temperature ADC
+	// temperature ADC, conversions triggered by timer 0 compare match A, see adc_complete()
 	pinMode(THERM_READ_PIN, INPUT);
+	ADMUX = (1 << REFS0) | (THERM_ADC_CHANNEL & 0x07);
+	ADCSRB = (((THERM_ADC_CHANNEL >> 3) & 0x01) << MUX5) | (1 << ADTS1) | (1 << ADTS0);
+	ADCSRA = (1 << ADEN) | (1 << ADATE) | (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
 
 	stop_led();
 	stop_motor();
@@ -101,45 +150,64 @@ Hardware::Hardware() {
 	myStepper.set_tbl(1);					// ([0-3]) set comparator blank time to 16, 24, 36 or 54 clocks, 1 or 2 is recommended
 	myStepper.set_toff(8);					// ([0-15]) 0: driver disable, 1: use only with TBL>2, 2-15: off time setting during slow decay phase
 	myStepper.set_en_pwm_mode(1);			// 0: driver disable PWM mode, 1: driver enable PWM mode
+	myStepper.set_dedge(1);					// ({0,1}) step on both edges, STEP_PIN is toggled by timer 3
 
+	mcp_inputs = outputchip.digitalRead();
 	cover_closed = is_cover_closed();
 	tank_inserted = is_tank_inserted();
 }
 
+// called by loop() once the ring buffer of the current channel is refilled
 void Hardware::read_adc() {
-	if (adc_channel) {
-		uvled_temp_celsius = interpolate_i16_ylin_P(read_adc_raw(THERM_READ_PIN) >> 2, 34, uvled_temp_table_raw, 1250, -50) / 10.0;
+	bool channel = adc_channel;
+	// ISR drops settling samples and then fills the other channel's ring buffer
+	adc_settle = ADC_SETTLE_SAMPLES;
+	adc_fresh = 0;
+	adc_channel = !channel;
+	int16_t raw = read_adc_raw(channel);
+	outputchip.digitalWrite(ANALOG_SWITCH_A, !channel);
+
+	if (channel) {
+		uvled_temp_celsius = thermistor_celsius(&uvled_thermistor, raw >> 2);
 		uvled_temp = config.SI_unit_system ? uvled_temp_celsius : celsius2fahrenheit(uvled_temp_celsius);
 	} else {
-		chamber_temp_celsius = interpolate_i16_ylin_P(read_adc_raw(THERM_READ_PIN) >> 2, 34, chamber_temp_table_raw, 1250, -50) / 10.0;
+		chamber_temp_celsius = thermistor_celsius(&chamber_thermistor, raw >> 2);
 		chamber_temp = config.SI_unit_system ? chamber_temp_celsius : celsius2fahrenheit(chamber_temp_celsius);
 
 		#ifdef CW1S
 			if(heater_on){
-				float error = config.target_temp - chamber_temp_celsius;
-				uint16_t pwm_duty = error > 0.0 ? round((error < 2.0 ? error : 2.0) * 980) : 0;
-				set_heater_pwm_duty(pwm_duty);
 				adjust_fan_speed(0, HEATING_ON_FAN1_DUTY);
 
 			}else{
-				adjust_fan_speed(0, chamber_temp_celsius > CHAMBER_TEMP_THR_FAN1_ON ? (fan_duty[0] > CHAMBER_TEMP_THR_FAN1_DUTY ? fan_duty[0] : CHAMBER_TEMP_THR_FAN1_DUTY) : fan_duty[0]);
+				adjust_fan_speed(0, chamber_temp_celsius > CHAMBER_TEMP_THR_FAN1_ON * 10 ? (fan_duty[0] > CHAMBER_TEMP_THR_FAN1_DUTY ? fan_duty[0] : CHAMBER_TEMP_THR_FAN1_DUTY) : fan_duty[0]);
 
 			}
 		#endif
 
 	}
-	adc_channel = !adc_channel;
-	outputchip.digitalWrite(ANALOG_SWITCH_A, adc_channel);
 }
 
-int16_t Hardware::read_adc_raw(uint8_t pin) {
+int16_t Hardware::read_adc_raw(uint8_t channel) {
 	int16_t raw = 0;
 	for (uint8_t i = 0; i < ADC_OVRSAMPL; ++i) {
-		raw += analogRead(pin);
+		raw += adc_samples[channel][i];
 	}
 	return raw;
 }
 
+// ADC conversion complete, runs every 1.024 ms
+void Hardware::adc_complete() {
+	uint16_t sample = ADC;
+	if (adc_settle) {
+		--adc_settle;
+		return;
+	}
+	adc_samples[adc_channel][adc_head] = sample;
+	adc_head = (adc_head + 1) % ADC_OVRSAMPL;
+	if (adc_fresh < ADC_OVRSAMPL)
+		++adc_fresh;
+}
+
 void Hardware::encoder_read() {
 	uint8_t enc = 0;
 	if (digitalRead(BTN_EN1) == HIGH) {
@@ -185,25 +253,54 @@ void Hardware::encoder_read() {
 		else if (rotary_diff < -124)
 			rotary_diff = -124;
 	}
+	// rotary "click" is 4 "micro steps", kept in rotary_diff while the queue is full,
+	// the last EVENT_QUEUE_RESERVED entries are left to switches and button
+	if (Events::count() < EVENT_QUEUE_SIZE - 1 - EVENT_QUEUE_RESERVED) {
+		if (rotary_diff > 3) {
+			rotary_diff -= 4;
+			Events::push(EVENT_CONTROL_UP);
+		} else if (rotary_diff < -3) {
+			rotary_diff += 4;
+			Events::push(EVENT_CONTROL_DOWN);
+		}
+	}
 }
 
 #ifdef CW1S
-	void Hardware::slow_pwm_tick() {
-		static uint16_t timer0_ticks = 0;
-		if(slow_pwm_on){
-			if(++timer0_ticks > 1000) timer0_ticks = 0;
-			wanted_heater_pin_state = timer0_ticks < heater_pwm_duty;
+	static_assert(HEATER_MIN_SWITCH * 1000L < INT16_MAX, "heater modulator error overflows");
+
+	// first order sigma-delta, error accumulates duty minus output (0/1000) every tick,
+	// output follows the sign of error but holds at least HEATER_MIN_SWITCH ticks
+	void Hardware::heater_modulator_tick() {
+		static int16_t error = 0;
+		static uint8_t hold = 0;
+		if (!heater_modulator_on || !heater_pwm_duty) {
+			error = 0;
+			hold = 0;
+			wanted_heater_pin_state = false;
+			return;
+		}
+		bool on = wanted_heater_pin_state;
+		error += on ? (int16_t)heater_pwm_duty - 1000 : (int16_t)heater_pwm_duty;
+		if (hold) {
+			--hold;
+		} else if (on != (error > 0)) {
+			wanted_heater_pin_state = !on;
+			hold = HEATER_MIN_SWITCH - 1;
 		}
 	}
 #endif
 
 void Hardware::run_motor() {
-	TIMSK3 |= (1 << OCIE3A); // enable stepper timer
+	OCR3A = microstep_control;
+	TCCR3A |= (1 << COM3A0); // toggle STEP_PIN on compare match
 	enable_stepper();
 }
 
 void Hardware::stop_motor() {
-	TIMSK3 = 0; // disable stepper timer
+	TCCR3A &= ~(1 << COM3A0); // STEP_PIN back to port value
+	TIMSK3 &= ~(1 << OCIE3A); // abort ramp
+	do_acceleration = false;
 	disable_stepper();
 }
 
@@ -216,6 +313,7 @@ void Hardware::disable_stepper() {
 }
 
 void Hardware::speed_configuration(uint8_t speed, bool fast_mode, bool gear_shifting) {
+	TIMSK3 &= ~(1 << OCIE3A);
 	if (fast_mode) {
 		myStepper.set_IHOLD_IRUN(31, 31, 5);
 		myStepper.set_mres(16);
@@ -224,32 +322,42 @@ void Hardware::speed_configuration(uint8_t speed, bool fast_mode, bool gear_shif
 		} else {
 			target_accel_period = map(speed, 1, 10, MIN_FAST_SPEED, MAX_FAST_SPEED);
 			microstep_control = FAST_SPEED_START;
-			accel_us_last = millis();
+			accel_steps = pgm_read_word(&accel_ramp.steps[0]);
 		}
 	} else {
 		myStepper.set_IHOLD_IRUN(10, 10, 0);
 		myStepper.set_mres(256);
 		microstep_control = map(speed, 1, 10, MIN_SLOW_SPEED, MAX_SLOW_SPEED);
 	}
+	OCR3A = microstep_control;
 	do_acceleration = fast_mode && !gear_shifting;
+	if (do_acceleration) {
+		TIFR3 = (1 << OCF3A); // clear stale match
+		TIMSK3 |= (1 << OCIE3A);
+	}
 }
 
+// called by step timer on every step while accelerating
 void Hardware::acceleration() {
-	if (microstep_control > target_accel_period) {
-		// step is 5 to MIN_FAST_SPEED+5, then step is 1
-		if (microstep_control > MIN_FAST_SPEED + 5)
-			microstep_control -= 4;
-		microstep_control--;
-	} else {
-		do_acceleration = false;
-		myStepper.set_IHOLD_IRUN(10, 10, 5);
-	}
+	if (--accel_steps)
+		return;
+	uint8_t period = microstep_control - 1;
+	if (period > target_accel_period)
+		accel_steps = pgm_read_word(&accel_ramp.steps[FAST_SPEED_START - period]);
+	else
+		TIMSK3 &= ~(1 << OCIE3A); // ramp done, Hardware::loop() lowers current
+	microstep_control = period;
+	OCR3A = period;
 }
 
 void Hardware::run_heater() {
 	#ifdef CW1S
 		heater_on = true;
-		slow_pwm_on = true;
+		heater_modulator_on = true;
+		heater_pid_on = true;
+		heater_pid_integral = 0;
+		heater_pid_temp = chamber_temp_celsius * 16;
+		heater_pid();
 	#else
 		outputchip.digitalWrite(FAN_HEAT_PIN, HIGH);
 	#endif
@@ -261,7 +369,7 @@ void Hardware::stop_heater() {
 	#ifdef CW1S
 		set_heater_pin_state(false);
 		heater_on = false;
-		slow_pwm_on = false;
+		heater_modulator_on = false;
 		set_heater_pwm_duty(0);
 	#else
 		outputchip.digitalWrite(FAN_HEAT_PIN, LOW);
@@ -280,12 +388,13 @@ void Hardware::stop_led() {
 	digitalWrite(LED_PWM_PIN, LOW);
 }
 
+// switches are decoded from the inputs snapshot taken by loop()
 bool Hardware::is_cover_closed() {
-	return outputchip.digitalRead(COVER_OPEN_PIN) == LOW;
+	return !(mcp_inputs & MCP_MASK(COVER_OPEN_PIN));
 }
 
 bool Hardware::is_tank_inserted() {
-	return outputchip.digitalRead(WASH_DETECT_PIN) == LOW;
+	return !(mcp_inputs & MCP_MASK(WASH_DETECT_PIN));
 }
 
 void Hardware::echo() {
@@ -342,18 +451,49 @@ void Hardware::set_fan2_duty(uint8_t duty) {
 		}
 	}
 
-	uint8_t Hardware::get_heater_pwm_duty() {
+	uint16_t Hardware::get_heater_pwm_duty() {
 		return heater_pwm_duty;
 	}
 
 	void Hardware::set_heater_pwm_duty(uint16_t duty) {
+		if(duty > 1000) duty = 1000;
+		// callers may already have interrupts disabled
+		uint8_t sreg = SREG;
+		cli();
 		heater_pwm_duty = duty;
-		if(heater_pwm_duty > 1000) heater_pwm_duty = 1000;
+		SREG = sreg;
 		if(duty == 0){
 			wanted_heater_pin_state = false;
 		}
 	}
 
+	// heater keeps the duty, PID is off until next run_heater()
+	void Hardware::set_heater_open_loop(uint16_t duty) {
+		heater_pid_on = false;
+		set_heater_pwm_duty(duty);
+	}
+
+	// chamber temperature PID, derivative acts on filtered measurement (no kick on target change,
+	// one ADC step is spread over several periods), integral is held while the output is
+	// saturated in the direction of the error (anti-windup), never cut back by P or D noise
+	static_assert(3LL * HEATER_PID_GAIN_MAX * HEATER_PID_ERROR_MAX < INT32_MAX, "heater PID terms overflow");
+
+	void Hardware::heater_pid() {
+		int16_t target = config.SI_unit_system ? config.target_temp * 10 : fahrenheit2celsius(config.target_temp * 10);
+		int16_t error = constrain(target - chamber_temp_celsius, -HEATER_PID_ERROR_MAX, HEATER_PID_ERROR_MAX);
+		int16_t temp = heater_pid_temp + ((chamber_temp_celsius * 16 - heater_pid_temp) >> HEATER_PID_D_FILTER);
+		int16_t change = constrain(heater_pid_temp - temp, -HEATER_PID_ERROR_MAX, HEATER_PID_ERROR_MAX);
+		int32_t p = (int32_t)config.heater_pid_kp * error;
+		int32_t d = ((int32_t)config.heater_pid_kd * change) >> 4;
+		heater_pid_temp = temp;
+		int32_t integral = constrain(heater_pid_integral + (int32_t)config.heater_pid_ki * error, 0, 1000L << 8);
+		int32_t output = p + integral + d;
+		if ((output <= (1000L << 8) || error < 0) && (output >= 0 || error > 0))
+			heater_pid_integral = integral;
+		int32_t duty = (p + heater_pid_integral + d) >> 8;
+		set_heater_pwm_duty(duty < 0 ? 0 : (duty > 1000 ? 1000 : duty));
+	}
+
 	void Hardware::set_heater_pin_state(bool value) {
 		if(heater_pin_state != value) {
 			outputchip.digitalWrite(FAN_HEAT_PIN, value);
@@ -363,22 +503,36 @@ void Hardware::set_fan2_duty(uint8_t duty) {
 #endif
 
 void Hardware::fans_duty() {
+	// both enable pins in one MCP write
+	uint16_t enable = 0;
 	for (uint8_t i = 0; i < 2; ++i) {
-		fans_duty(i, fan_duty[i]);
+		fans_pwm(i, fan_duty[i]);
+		if (fan_duty[i]) {
+			enable |= MCP_MASK(fan_enable_pins[i]);
+		}
 	}
+	outputchip.digitalWriteMask(MCP_MASK(fan_enable_pins[0]) | MCP_MASK(fan_enable_pins[1]), enable);
 }
 
 void Hardware::fans_duty(uint8_t fan, uint8_t duty) {
+	fan_duty[fan] = duty;
+	fans_pwm(fan, duty);
+	outputchip.digitalWrite(fan_enable_pins[fan], duty ? HIGH : LOW);
+}
+
+void Hardware::fans_pwm(uint8_t fan, uint8_t duty) {
+	if (duty && fan_rpm_control(fan)) {
+		duty = fan_rpm_output(fan, (uint32_t)FAN_RPM_NOMINAL * duty / 100);
+	}
+	fan_output[fan] = duty;
 	USB_PRINTP("fan ");
 	USB_PRINT(fan);
 	USB_PRINTP("->");
 	if (duty) {
 		USB_PRINTLN(duty);
 		analogWrite(fan_pwm_pins[fan], map(duty, 0, 100, 255, 0));
-		outputchip.digitalWrite(fan_enable_pins[fan], HIGH);
 	} else {
 		USB_PRINTLNP("OFF");
-		outputchip.digitalWrite(fan_enable_pins[fan], LOW);
 		digitalWrite(fan_pwm_pins[fan], LOW);
 	}
 }
@@ -389,18 +543,18 @@ void Hardware::fans_PI_regulator() {
 //	USB_PRINTLN(chamber_temp);
 //	USB_PRINTP("target: ");
 //	USB_PRINTLN(fans_target_temp);
-	double err_value = chamber_temp - fans_target_temp;
+	int16_t err_value = chamber_temp - fans_target_temp * 10;
 //	USB_PRINTP("err: ");
 //	USB_PRINTLN(err_value);
 	PI_summ_err += err_value;
 //	USB_PRINTP("sum: ");
 //	USB_PRINTLN(PI_summ_err);
 
-	if ((PI_summ_err > 10000) || (PI_summ_err < -10000)) {
-		PI_summ_err = 10000;
+	if ((PI_summ_err > 100000) || (PI_summ_err < -100000)) {
+		PI_summ_err = 100000;
 	}
 
-	double new_speed = P * err_value + I * PI_summ_err;		// TODO uint8_t?
+	int32_t new_speed = (P * err_value + PI_summ_err / I_INV) / 10;
 //	USB_PRINTP("PI new value: ");
 //	USB_PRINTLN(new_speed);
 	if (new_speed > 100) {
@@ -416,32 +570,143 @@ void Hardware::fans_PI_regulator() {
 	}
 }
 
+void Hardware::set_fans_learning(bool learning) {
+	fans_learning = learning;
+	fans_duty();
+}
+
+static_assert(MIN_FAN_SPEED + (FAN_CURVE_POINTS - 1) * FAN_CURVE_STEP == 100, "fan curve doesn't end at 100 %");
+
+// learned curve rises from a spinning first point
+bool Hardware::fan_curve_valid(const uint16_t* curve) {
+	if (!curve[0]) {
+		return false;
+	}
+	for (uint8_t i = 1; i < FAN_CURVE_POINTS; ++i) {
+		if (curve[i] < curve[i - 1]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Hardware::fan_rpm_control(uint8_t fan) {
+	return config.fans_rpm_control && !fans_learning && fan_curve_valid(config.fans_curve[fan]);
+}
+
+// duty from the learned curve plus the integral correction
+uint8_t Hardware::fan_rpm_output(uint8_t fan, uint16_t target) {
+	const uint16_t* curve = config.fans_curve[fan];
+	int16_t duty = 100;
+	if (target <= curve[0]) {
+		duty = MIN_FAN_SPEED;
+	} else {
+		for (uint8_t i = 1; i < FAN_CURVE_POINTS; ++i) {
+			if (target <= curve[i]) {
+				duty = MIN_FAN_SPEED + (i - 1) * FAN_CURVE_STEP + (uint32_t)(target - curve[i - 1]) * FAN_CURVE_STEP / (curve[i] - curve[i - 1]);
+				break;
+			}
+		}
+	}
+	duty += fan_rpm_integral[fan] >> 12;
+	return constrain(duty, MIN_FAN_SPEED, 100);
+}
+
+void Hardware::fans_rpm_regulator() {
+	for (uint8_t i = 0; i < 2; ++i) {
+		if (!fan_duty[i] || !fan_rpm_control(i)) {
+			fan_rpm_integral[i] = 0;
+			fan_degraded[i] = 0;
+			continue;
+		}
+		uint16_t target = (uint32_t)FAN_RPM_NOMINAL * fan_duty[i] / 100;
+		int32_t integral = fan_rpm_integral[i] + (int32_t)FAN_RPM_KI * ((int16_t)target - (int16_t)fan_rpm[i]);
+		fan_rpm_integral[i] = constrain(integral, -(FAN_RPM_LIMIT << 12), FAN_RPM_LIMIT << 12);
+		uint8_t duty = fan_rpm_output(i, target);
+		// out of correction and still well below target
+		if ((duty == 100 || fan_rpm_integral[i] == FAN_RPM_LIMIT << 12) && fan_rpm[i] < target - target / 8) {
+			if (++fan_degraded[i] >= FAN_DEGRADED_TIME) {
+				fan_errors |= 1 << i;
+				fan_degraded[i] = 0;
+			}
+		} else {
+			fan_degraded[i] = 0;
+		}
+		if (duty != fan_output[i]) {
+			fan_output[i] = duty;
+			analogWrite(fan_pwm_pins[i], map(duty, 0, 100, 255, 0));
+		}
+	}
+}
+
+// called from tacho interrupts, keeps the last FAN_TACHO_PERIODS edge to edge periods
+void Hardware::fan_tacho(uint8_t fan) {
+	unsigned long us_now = micros();
+	if (fan_tacho_edges[fan]) {
+		unsigned long period = (us_now - fan_tacho_us_last[fan]) >> FAN_TACHO_SHIFT;
+		fan_tacho_period[fan][fan_tacho_index[fan]] = period < UINT16_MAX ? period : UINT16_MAX;
+		if (++fan_tacho_index[fan] == FAN_TACHO_PERIODS)
+			fan_tacho_index[fan] = 0;
+	}
+	if (fan_tacho_edges[fan] <= FAN_TACHO_PERIODS)
+		++fan_tacho_edges[fan];
+	fan_tacho_us_last[fan] = us_now;
+}
+
+// tacho pulses per minute from median of the last periods, same scale as the former pulse count
 void Hardware::fans_check() {
 	for (uint8_t i = 0; i < 3; ++i) {
-		fan_rpm[i] = 60000 / FAN_CHECK_PERIOD * fan_tacho_count[i];
-		fan_tacho_count[i] = 0;
+		uint16_t periods[FAN_TACHO_PERIODS];
+		cli();
+		uint8_t count = fan_tacho_edges[i] ? fan_tacho_edges[i] - 1 : 0;
+		bool stalled = micros() - fan_tacho_us_last[i] > FAN_TACHO_TIMEOUT * 1000UL;
+		if (stalled) {
+			fan_tacho_edges[i] = 0;
+			fan_tacho_index[i] = 0;
+		}
+		for (uint8_t j = 0; j < count; ++j)
+			periods[j] = fan_tacho_period[i][j];
+		sei();
+		if (stalled || !count) {
+			fan_rpm[i] = 0;
+			continue;
+		}
+		for (uint8_t j = 1; j < count; ++j) {
+			uint16_t period = periods[j];
+			uint8_t k = j;
+			for (; k && periods[k - 1] > period; --k)
+				periods[k] = periods[k - 1];
+			periods[k] = period;
+		}
+		fan_rpm[i] = (60000000UL >> FAN_TACHO_SHIFT) / periods[count / 2];
 //		USB_PRINT(i);
 //		USB_PRINTP(": ");
 //		USB_PRINTLN(fan_rpm[i]);
 	}
+	fans_rpm_regulator();
 }
 
-uint8_t Hardware::loop() {
-	unsigned long us_now = millis();
-	if (do_acceleration && us_now - accel_us_last >= 50) {
-		accel_us_last = us_now;
-		acceleration();
+void Hardware::fans_PI_task() {
+	if (fans_target_temp) {
+		fans_PI_regulator();
 	}
-	if (us_now - fans_us_last >= FAN_CHECK_PERIOD) {
-		fans_us_last = us_now;
-		fans_check();
+}
+
+#ifdef CW1S
+	void Hardware::heater_pid_task() {
+		if (heater_on && heater_pid_on) {
+			heater_pid();
+		}
+	}
+#endif
+
+uint8_t Hardware::loop() {
+	if (do_acceleration && !(TIMSK3 & (1 << OCIE3A))) {
+		do_acceleration = false;
+		myStepper.set_IHOLD_IRUN(10, 10, 5);
 	}
-	if (us_now - adc_us_last >= 500) {
-		adc_us_last = us_now;
+	if (adc_fresh == ADC_OVRSAMPL) {
 		read_adc();
-		if (fans_target_temp) {
-			fans_PI_regulator();
-		}
 	}
 
 	#ifdef CW1S
@@ -450,67 +715,139 @@ uint8_t Hardware::loop() {
 		}
 	#endif
 
-	uint8_t events = 0;
+	// all MCP inputs in one SPI transaction
+	#ifdef MCP_INTA_PIN
+		// only on change, periodically anyway in case the expander lost its setup
+		if (!FAST_READ(MCP_INTA_PIN)) {
+			// inputs at the first change, a switch flipped back before this read still gives both edges
+			if (!mcp_capture_pending) {
+				mcp_capture = outputchip.interruptCapture();
+				mcp_capture_pending = true;
+			}
+			mcp_inputs = outputchip.digitalRead();
+		} else if (Scheduler::due(Scheduler::TASK_MCP_POLL)) {
+			mcp_inputs = outputchip.digitalRead();
+		}
+	#else
+		mcp_inputs = outputchip.digitalRead();
+	#endif
+
 	if (heater_error)
-		return events;
+		return 0;
 
 	#ifndef CW1S
 		// failed once, failed every time
-		heater_error = heater_us_last && !fan_rpm[2] && us_now - heater_us_last > HEATER_CHECK_DELAY;
+		heater_error = heater_us_last && !fan_rpm[2] && millis() - heater_us_last > HEATER_CHECK_DELAY;
+	#endif
+
+	#ifdef MCP_INTA_PIN
+		// captured inputs first, the current ones once all their edges are queued
+		if (mcp_capture_pending)
+			mcp_capture_pending = !input_events(mcp_capture);
+		if (!mcp_capture_pending)
+			input_events(mcp_inputs);
+	#else
+		input_events(mcp_inputs);
 	#endif
 
+	// one event per pass, the rest waits in the queue
+	Events::event_t event;
+	if (!Events::pop(event))
+		return 0;
+	if (event.type & (EVENT_CONTROL_UP | EVENT_CONTROL_DOWN)) {
+		// waiting detents of the same direction are handled and redrawn at once
+		control_detents = 0;
+		control_steps = 0;
+		do {
+			++control_detents;
+			control_steps += control_acceleration(event.type, event.us);
+		} while (control_detents < EVENT_QUEUE_SIZE && Events::pop_if(event.type, event));
+	}
+	if (config.sound_response && event.type & (EVENT_BUTTON_LONG_PRESS | EVENT_BUTTON_SHORT_PRESS | EVENT_CONTROL_DOWN | EVENT_CONTROL_UP)) {
+		echo();
+	}
+	return event.type;
+}
+
+// detent interval (milliseconds) and steps per detent from the fastest
+static const uint8_t encoder_acceleration[][2] PROGMEM = {
+	{20, 10},
+	{40, 5},
+	{80, 2},
+};
+static_assert(EVENT_QUEUE_SIZE * 10 <= UINT8_MAX, "control_steps overflows");
+
+// detent timestamps are taken by encoder_read(), so a blocked main loop doesn't accelerate
+uint8_t Hardware::control_acceleration(uint8_t type, unsigned long us) {
+	static unsigned long us_last = 0;
+	static uint8_t type_last = 0;
+	unsigned long interval = us - us_last;
+	us_last = us;
+	if (type != type_last) {
+		type_last = type;
+		return 1;
+	}
+	for (uint8_t i = 0; i < COUNT_ITEMS(encoder_acceleration); ++i) {
+		if (interval < pgm_read_byte(&encoder_acceleration[i][0]) * 1000UL)
+			return pgm_read_byte(&encoder_acceleration[i][1]);
+	}
+	return 1;
+}
+
+// switches and button keep their state until the event is queued, a full queue retries next pass,
+// true once every change in inputs is queued
+bool Hardware::input_events(uint16_t inputs) {
 	// cover
-	bool cover_closed_now = is_cover_closed();
-	if (cover_closed_now != cover_closed) {
-		if (cover_closed_now)
-			events |= EVENT_COVER_CLOSED;
-		else
-			events |= EVENT_COVER_OPENED;
+	bool cover_closed_now = !(inputs & MCP_MASK(COVER_OPEN_PIN));
+	if (cover_closed_now != cover_closed && push_event(cover_closed_now ? EVENT_COVER_CLOSED : EVENT_COVER_OPENED)) {
 		cover_closed = cover_closed_now;
 	}
 
 	// tank
-	bool tank_inserted_now = is_tank_inserted();
-	if (tank_inserted_now != tank_inserted) {
-		if (tank_inserted_now)
-			events |= EVENT_TANK_INSERTED;
-		else
-			events |= EVENT_TANK_REMOVED;
+	bool tank_inserted_now = !(inputs & MCP_MASK(WASH_DETECT_PIN));
+	if (tank_inserted_now != tank_inserted && push_event(tank_inserted_now ? EVENT_TANK_INSERTED : EVENT_TANK_REMOVED)) {
 		tank_inserted = tank_inserted_now;
 	}
 
 	// button
-	if (outputchip.digitalRead(BTN_ENC) == LOW) {
+	bool button_pressed = !(inputs & MCP_MASK(BTN_ENC));
+	if (button_pressed) {
 		if (!button_active) {
 			button_active = true;
 			button_timer = millis();
 		} else if (!long_press_active && millis() - button_timer > LONG_PRESS_TIME) {
-			long_press_active = true;
-			events |= EVENT_BUTTON_LONG_PRESS;
+			long_press_active = push_event(EVENT_BUTTON_LONG_PRESS);
 		}
 	} else if (button_active) {
 		if (long_press_active) {
 			long_press_active = false;
+			button_active = false;
 		} else {
-			events |= EVENT_BUTTON_SHORT_PRESS;
+			button_active = !push_event(EVENT_BUTTON_SHORT_PRESS);
 		}
-		button_active = false;
-	}
-
-	// rotary "click" is 4 "micro steps"
-	if (rotary_diff > 3) {
-		rotary_diff -= 4;
-		events |= EVENT_CONTROL_UP;
-	} else if (rotary_diff < -3) {
-		rotary_diff += 4;
-		events |= EVENT_CONTROL_DOWN;
 	}
+	return cover_closed == cover_closed_now && tank_inserted == tank_inserted_now && button_active == button_pressed;
+}
 
-	if (config.sound_response && events & (EVENT_BUTTON_LONG_PRESS | EVENT_BUTTON_SHORT_PRESS | EVENT_CONTROL_DOWN | EVENT_CONTROL_UP)) {
-		echo();
-	}
+// main loop side producer, encoder ISR pushes to the same queue
+bool Hardware::push_event(uint8_t type) {
+	cli();
+	bool pushed = Events::push(type);
+	sei();
+	return pushed;
+}
 
-	return events;
+// no interrupt left work for loop(), called with interrupts disabled
+bool Hardware::is_idle() {
+	#ifdef MCP_INTA_PIN
+		if (!FAST_READ(MCP_INTA_PIN) || mcp_capture_pending)
+			return false;
+	#endif
+	#ifdef CW1S
+		if (wanted_heater_pin_state != heater_pin_state)
+			return false;
+	#endif
+	return adc_fresh < ADC_OVRSAMPL && Events::empty() && !button_active && !do_acceleration;
 }
 
 Hardware hw;
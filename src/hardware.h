@@ -13,14 +13,16 @@
 #define EVENT_CONTROL_UP			64
 #define EVENT_CONTROL_DOWN			128
 
-float celsius2fahrenheit(float);
-float fahrenheit2celsius(float);
+// temperatures are held in deci-degrees (0.1 degree units)
+int16_t celsius2fahrenheit(int16_t);
+int16_t fahrenheit2celsius(int16_t);
 
 class Hardware {
 public:
 	Hardware();
 
 	static void encoder_read();
+	static void adc_complete();
 
 	static void run_motor();
 	static void stop_motor();
@@ -47,70 +49,109 @@ public:
 	static void set_fan1_duty(uint8_t duty);
 	static void set_fan2_duty(uint8_t duty);
 
-	static uint8_t loop();
+	static uint8_t loop();	// @return next EVENT_* or 0
+	static bool is_idle();
 
+	// scheduler tasks
+	static void fans_check();
+	static void fans_PI_task();
 	#ifdef CW1S
-		static void slow_pwm_tick();
+		static void heater_pid_task();
+	#endif
+	static void fan_tacho(uint8_t fan);
+	static void set_fans_learning(bool learning);
+	static bool fan_curve_valid(const uint16_t* curve);
+
+	#ifdef CW1S
+		static void heater_modulator_tick();
 		static void adjust_fan_speed(uint8_t fan, uint8_t duty);
-		static uint8_t get_heater_pwm_duty();
+		static uint16_t get_heater_pwm_duty();
 		static void set_heater_pwm_duty(uint16_t duty);
+		static void set_heater_open_loop(uint16_t duty);
 	#endif
 
 	static uint16_t fan_rpm[3];
-	static volatile uint8_t fan_tacho_count[3];
 	static volatile uint8_t microstep_control;
-	static float chamber_temp_celsius;
-	static float chamber_temp;
-	static float uvled_temp_celsius;
-	static float uvled_temp;
+	static int16_t chamber_temp_celsius;
+	static int16_t chamber_temp;
+	static int16_t uvled_temp_celsius;
+	static int16_t uvled_temp;
 	static bool heater_error;
+	static uint8_t fan_errors;
+	static uint8_t control_detents;	// coalesced into the last EVENT_CONTROL_*
+	static uint8_t control_steps;	// the same detents scaled by encoder acceleration
 	#ifdef CW1S
-		static bool wanted_heater_pin_state;
-		static bool slow_pwm_on;
+		static volatile bool wanted_heater_pin_state;
+		static volatile bool heater_modulator_on;
 	#endif
 
 private:
 	static MCP outputchip;
 	static Trinamic_TMC2130 myStepper;
 
+	static bool push_event(uint8_t type);
+	static bool input_events(uint16_t inputs);
+	static uint8_t control_acceleration(uint8_t type, unsigned long us);
 	static void read_adc();
-	static int16_t read_adc_raw(uint8_t pin);
+	static int16_t read_adc_raw(uint8_t channel);
 	static void fans_duty();
 	static void fans_duty(uint8_t fan, uint8_t duty);
+	static void fans_pwm(uint8_t fan, uint8_t duty);
 	static void fans_PI_regulator();
-	static void fans_check();
+	static bool fan_rpm_control(uint8_t fan);
+	static uint8_t fan_rpm_output(uint8_t fan, uint16_t target);
+	static void fans_rpm_regulator();
 	#ifdef CW1S
 		static void set_heater_pin_state(bool value);
+		static void heater_pid();
 	#endif
 
+	static uint16_t mcp_inputs;
+	#ifdef MCP_INTA_PIN
+		static uint16_t mcp_capture;
+		static bool mcp_capture_pending;
+	#endif
 	static uint8_t lcd_encoder_bits;
 	static volatile int8_t rotary_diff;
 	static uint8_t target_accel_period;
+	static volatile uint16_t accel_steps;
 
 	static uint8_t fan_duty[2];
 	static uint8_t fan_pwm_pins[2];
 	static uint8_t fan_enable_pins[2];
 	static uint8_t fans_target_temp;
 
-	static uint8_t fan_errors;
+	static uint8_t fan_output[2];
+	static int32_t fan_rpm_integral[2];
+	static uint8_t fan_degraded[2];
+	static bool fans_learning;
+
+	static volatile unsigned long fan_tacho_us_last[3];
+	static volatile uint16_t fan_tacho_period[3][FAN_TACHO_PERIODS];
+	static volatile uint8_t fan_tacho_index[3];
+	static volatile uint8_t fan_tacho_edges[3];
 
-	static unsigned long accel_us_last;
-	static unsigned long fans_us_last;
-	static unsigned long adc_us_last;
 	static unsigned long heater_us_last;
 	static unsigned long button_timer;
-	static double PI_summ_err;
+	static int32_t PI_summ_err;
 	static bool do_acceleration;
 	static bool cover_closed;
 	static bool tank_inserted;
 	static bool button_active;
 	static bool long_press_active;
-	static bool adc_channel;
+	static volatile bool adc_channel;
+	static volatile uint8_t adc_settle;
+	static volatile uint8_t adc_fresh;
+	static uint8_t adc_head;
+	static uint16_t adc_samples[2][ADC_OVRSAMPL];
 
 	#ifdef CW1S
 		static bool heater_on;
 		static bool heater_pin_state;
-		static uint16_t heater_pwm_duty;
+		static volatile uint16_t heater_pwm_duty;
+		static bool heater_pid_on;
+		static int32_t heater_pid_integral;
+		static int16_t heater_pid_temp;		// filtered, 1/16 of 0.1 celsius
 	#endif
 };
 
@@ -4,6 +4,7 @@
 #include "config.h"
 #include "ui.h"
 #include "states.h"
+#include "scheduler.h"
 #include "LiquidCrystal_Prusa.h"
 
 const char* pgmstr_serial_number = reinterpret_cast<const char*>(0x7fe0); // see SN_LENGTH!!!
@@ -75,45 +76,50 @@ void setupTimer0() {
 ISR(TIMER0_COMPA_vect) {
 	hw.encoder_read();
 	#ifdef CW1S
-		hw.slow_pwm_tick();
+		hw.heater_modulator_tick();
 	#endif
 }
 
-// timer for stepper move
+// timer for stepper move, STEP_PIN (OC3A) is toggled by the timer itself,
+// stepper driver steps on both edges
 void setupTimer3() {
 	// Clear registers
 	TCCR3A = 0;
 	TCCR3B = 0;
 	TCNT3 = 0;
-	// 1 Hz (16000000/((15624+1)*1024))
-	OCR3A = 200;
-	// CTC
-	TCCR3B |= (1 << WGM32);
-	// Prescaler 1024
+	OCR3A = FAST_SPEED_START;
+	// Fast PWM with TOP = OCR3A, double buffered OCR3A makes speed changes glitch free
+	TCCR3A |= (1 << WGM31) | (1 << WGM30);
+	TCCR3B |= (1 << WGM33) | (1 << WGM32);
+	// Prescaler 64
 	TCCR3B |= (1 << CS31) | (1 << CS30);
-	// Start with interrupt disabled
+	// Compare interrupt runs the acceleration ramp only, compare output is connected by Hardware::run_motor()
 	TIMSK3 = 0;
 }
 
 ISR(TIMER3_COMPA_vect) {
-	OCR3A = hw.microstep_control;
-	digitalWrite(STEP_PIN, HIGH);
-	delayMicroseconds(2);
-	digitalWrite(STEP_PIN, LOW);
-	delayMicroseconds(2);
+	hw.acceleration();
+}
+
+ISR(ADC_vect) {
+	hw.adc_complete();
+}
+
+ISR(EE_READY_vect) {
+	write_config_next();
 }
 
 void fan_tacho1() {
-	hw.fan_tacho_count[0]++;
+	hw.fan_tacho(0);
 }
 
 void fan_tacho2() {
-	hw.fan_tacho_count[1]++;
+	hw.fan_tacho(1);
 }
 
 #ifndef CW1S
 	void fan_tacho3() {
-		hw.fan_tacho_count[2]++;
+		hw.fan_tacho(2);
 	}
 #endif
 
@@ -145,6 +151,7 @@ void setup() {
 
 	States::init();
 	UI::init();
+	Scheduler::init();
 
 	#ifdef CW1S
 		hw.set_heater_pwm_duty(0);
@@ -155,7 +162,9 @@ void setup() {
 	if(memcmp_P(model_cmp, pgmstr_serial_number, 3) != 0) {
 		lcd.clear();
 		lcd.print_P(pgmstr_wrong_model, (20 - strlen_P(pgmstr_wrong_model)) / 2, 1);
-		while(1);
+		while(1) {
+			lcd.flush();
+		}
 	}
 }
 
@@ -164,10 +173,16 @@ void loop() {
 		wdt_reset();
 	}
 
-	uint8_t events = hw.loop();
-	States::loop(events);
-	UI::loop(events);
+	Scheduler::loop();
+	uint8_t event = hw.loop();
+	States::loop(event);
+	UI::loop(event);
+	lcd.flush();
 
+	// sleeps less than the shortest task period, watchdog is kept fed above
+	if (!event && States::active_state == &States::menu && lcd.is_flushed()) {
+		Scheduler::idle();
+	}
 }
 
 /*
@@ -31,6 +31,9 @@
 #define LED_PWM_PIN					3
 #define WASH_DETECT_PIN				MCP_A1
 #define COVER_OPEN_PIN				MCP_A2
+// MCP23S17 INTA is not routed on rev 0.4, define it when wired to read
+// MCP inputs only on change instead of every loop
+//#define MCP_INTA_PIN				23
 
 #define FAN1_PIN					MCP_B3
 #define FAN1_PWM_PIN				13
@@ -48,3 +51,4 @@
 #define ANALOG_SWITCH_A				MCP_B1
 #define ANALOG_SWITCH_B				MCP_B0
 #define THERM_READ_PIN				22
+#define THERM_ADC_CHANNEL			1		// THERM_READ_PIN is A4 = ADC1
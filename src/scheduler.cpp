@@ -0,0 +1,115 @@
+#include <avr/sleep.h>
+
+#include "scheduler.h"
+#include "hardware.h"
+#include "config.h"
+
+namespace Scheduler {
+
+	struct task_t {
+		void (*run)();
+		uint16_t period;	// milliseconds
+		uint16_t deadline;	// milliseconds after release
+	};
+
+	// in task_id order
+	static const task_t tasks[] PROGMEM = {
+		{hw.fans_check, FAN_CHECK_PERIOD, FAN_CHECK_PERIOD / 2},
+		{hw.fans_PI_task, 500, 100},
+	#ifdef CW1S
+		{hw.heater_pid_task, HEATER_PID_PERIOD, 100},
+	#endif
+	#ifdef MCP_INTA_PIN
+		{nullptr, MCP_POLL_PERIOD, MCP_POLL_PERIOD},
+	#else
+		{nullptr, MCP_IDLE_POLL_PERIOD, MCP_IDLE_POLL_PERIOD},
+	#endif
+		{write_config_task, 250, 250},
+		{nullptr, 250, 100},
+		{nullptr, 1000, 500},
+		{nullptr, 100, 50},
+		{nullptr, MENU_REDRAW_US, 500},
+	};
+	static_assert(COUNT_ITEMS(tasks) == TASK_COUNT, "task table doesn't match task_id");
+	static_assert(TASK_COUNT <= 16, "due mask is 16 bits");
+
+	task_stats_t stats[TASK_COUNT];
+
+	static uint16_t next[TASK_COUNT];
+	static uint16_t next_any = 0;	// earliest of next[]
+	static uint16_t due_mask = 0;
+
+	void init() {
+		uint16_t ms_now = millis();
+		for (uint8_t i = 0; i < TASK_COUNT; ++i) {
+			next[i] = ms_now + pgm_read_word(&tasks[i].period);
+		}
+		next_any = ms_now;
+	}
+
+	void loop() {
+		due_mask = 0;
+		uint16_t ms_now = millis();
+		if ((int16_t)(ms_now - next_any) < 0) {
+			return;
+		}
+		uint16_t ms_first = ms_now + UINT16_MAX / 2;
+		for (uint8_t i = 0; i < TASK_COUNT; ++i) {
+			int16_t lateness = ms_now - next[i];
+			if (lateness < 0) {
+				if ((int16_t)(next[i] - ms_first) < 0) {
+					ms_first = next[i];
+				}
+				continue;
+			}
+			uint16_t period = pgm_read_word(&tasks[i].period);
+			if (lateness > stats[i].max_late) {
+				stats[i].max_late = lateness < UINT8_MAX ? lateness : UINT8_MAX;
+			}
+			if (lateness > (int16_t)pgm_read_word(&tasks[i].deadline)) {
+				// skip missed releases instead of running back to back
+				++stats[i].late;
+				next[i] = ms_now + period;
+			} else {
+				next[i] += period;
+			}
+			++stats[i].runs;
+			due_mask |= 1 << i;
+			void (*run)() = reinterpret_cast<void (*)()>(pgm_read_ptr(&tasks[i].run));
+			if (run) {
+				unsigned long us_start = micros();
+				run();
+				unsigned long us = micros() - us_start;
+				if (us > stats[i].max_us) {
+					stats[i].max_us = us < UINT16_MAX ? us : UINT16_MAX;
+				}
+			}
+			if ((int16_t)(next[i] - ms_first) < 0) {
+				ms_first = next[i];
+			}
+		}
+		next_any = ms_first;
+	}
+
+	// timer 0 still wakes the MCU every millisecond (millis() and the encoder),
+	// the main loop is skipped until there is something to do
+	void idle() {
+		set_sleep_mode(SLEEP_MODE_IDLE);
+		for (;;) {
+			cli();
+			if ((int16_t)(millis() - next_any) >= 0 || !hw.is_idle()) {
+				sei();
+				return;
+			}
+			sleep_enable();
+			sei();	// the instruction after sei is executed before any pending interrupt
+			sleep_cpu();
+			sleep_disable();
+		}
+	}
+
+	bool due(task_id task) {
+		return due_mask & (1 << task);
+	}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+// Cooperative scheduler with a compile-time task table (scheduler.cpp).
+// Scheduler::loop() runs once per main loop pass: tasks with a function are
+// run when due, tasks without one only flag their period for this pass to the
+// code polling them by Scheduler::due(). Every release is checked against the
+// task deadline (jitter of the main loop) and run time of tasks with a function
+// is measured.
+// Scheduler::idle() puts the MCU into idle sleep until the next release or
+// until an interrupt leaves work for the main loop.
+
+#include <stdint.h>
+#include "defines.h"
+
+namespace Scheduler {
+
+	enum task_id : uint8_t {
+		TASK_FANS,			// Hardware::fans_check()
+		TASK_FANS_PI,		// Hardware::fans_PI_task()
+	#ifdef CW1S
+		TASK_HEATER_PID,	// Hardware::heater_pid_task()
+	#endif
+		TASK_MCP_POLL,		// Hardware::loop() MCP inputs without INTA change or while sleeping
+		TASK_CONFIG,		// write_config_task()
+		TASK_SWITCH_TEST,	// States::Test_switch
+		TASK_BEEP,			// States::Confirm
+		TASK_SPINNER,		// UI::State
+		TASK_REDRAW,		// UI::Menu_self_redraw
+		TASK_COUNT
+	};
+
+	struct task_stats_t {
+		uint16_t runs;
+		uint16_t late;		// released more than deadline ago
+		uint16_t max_us;	// longest run of task function
+		uint8_t max_late;	// milliseconds from release to run
+	};
+
+	extern task_stats_t stats[TASK_COUNT];
+
+	void init();
+	void loop();
+	void idle();
+	bool due(task_id task);
+
+}
@@ -27,13 +27,16 @@ void SimplePrint::print(uint16_t number, uint16_t denom, unsigned char filler) {
 	}
 }
 
-void SimplePrint::print(float number) {
-	number += 0.05;
-	uint8_t integer = (uint8_t)number;
-	print(integer, 100, ' ');
+// prints deci-units (temperature) as "xxx.x"
+void SimplePrint::print(int16_t deci) {
+	if (deci < 0) {
+		write('-');
+		deci = -deci;
+	}
+	div_t division = div(deci, 10);
+	print((uint16_t)division.quot, 100, ' ');
 	write('.');
-	integer = (number - integer) * 10;
-	print(integer, 1);
+	write(division.rem + '0');
 }
 
 void SimplePrint::printTime(uint16_t time) {
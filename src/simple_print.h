@@ -7,7 +7,7 @@ public:
 	SimplePrint();
 	void print(uint16_t number, uint16_t denom = 10000, unsigned char filler = ' ');
 	void print(uint8_t number, uint8_t denom = 100, unsigned char filler = ' ');
-	void print(float);
+	void print(int16_t deci);
 	void printTime(uint16_t time);
 	void print(const char*);
 	void print_P(const char*);
@@ -86,6 +86,16 @@ namespace States {
 		pgmstr_close_cover,
 		hw.is_cover_closed);
 
+	Fans_calibration fans_calibration(
+		pgmstr_fans_calibration,
+		&confirm);
+
+	#ifdef CW1S
+		Heater_autotune heater_autotune(
+			pgmstr_heater_autotune,
+			&confirm);
+	#endif
+
 
 	/*** states data ***/
 	Base* active_state = &menu;
@@ -18,6 +18,10 @@ namespace States {
 	extern Warmup warmup_resin;
 	extern Base cooldown;
 	extern Test_switch selftest_cover;
+	extern Fans_calibration fans_calibration;
+	#ifdef CW1S
+		extern Heater_autotune heater_autotune;
+	#endif
 
 	void init();
 	void loop(uint8_t events);
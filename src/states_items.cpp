@@ -1,4 +1,5 @@
 #include "states.h"
+#include "scheduler.h"
 
 namespace States {
 
@@ -59,12 +60,17 @@ namespace States {
 			error.new_text(pgmstr_heater_error, pgmstr_please_restart);
 			return &error;
 		}
+		if (hw.fan_errors) {
+			error.new_text(hw.fan_errors & FAN1_ERROR_MASK ? pgmstr_fan1_failure : pgmstr_fan2_failure, pgmstr_not_spinning);
+			hw.fan_errors = 0;
+			return &error;
+		}
 		if (options & STATE_OPTION_UVLED) {
-			if (hw.uvled_temp_celsius < 0.0) {
+			if (hw.uvled_temp_celsius < 0) {
 				error.new_text(pgmstr_led_failure, pgmstr_read_temp_error);
 				return &error;
 			}
-			if (hw.uvled_temp_celsius > UVLED_MAX_TEMP) {
+			if (hw.uvled_temp_celsius > UVLED_MAX_TEMP * 10) {
 				error.new_text(pgmstr_led_failure, pgmstr_overheat_error);
 				return &error;
 			}
@@ -164,14 +170,14 @@ namespace States {
 		return UINT16_MAX;
 	}
 
-	float Base::get_temperature() {
+	int16_t Base::get_temperature() {
 		if (options & STATE_OPTION_CHAMB_TEMP) {
 			return hw.chamber_temp;
 		}
 		if (options & STATE_OPTION_UVLED_TEMP) {
 			return hw.uvled_temp;
 		}
-		return -40.0;
+		return -400;
 	}
 
 	const char* Base::decrease_time() {
@@ -252,7 +258,12 @@ namespace States {
 	{}
 
 	Base* Warmup::loop() {
-		if (!config.heat_to_target_temp || hw.chamber_temp >= *target_temp) {
+		#ifdef CW1S
+			int16_t reached = *target_temp * 10 - WARMUP_TEMP_TOLERANCE;
+		#else
+			int16_t reached = *target_temp * 10;
+		#endif
+		if (!config.heat_to_target_temp || hw.chamber_temp >= reached) {
 			return continue_to;
 		}
 		return Base::loop();
@@ -261,13 +272,13 @@ namespace States {
 
 	// States::Confirm
 	Confirm::Confirm(bool force_wait) :
-		Base(pgmstr_emptystr, STATE_OPTION_SHORT_CANCEL), force_wait(force_wait), quit(false)
+		Base(pgmstr_emptystr, STATE_OPTION_SHORT_CANCEL), force_wait(force_wait), quit(false), beeping(false)
 	{}
 
 	void Confirm::start() {
 		canceled = false;
 		quit = true;
-		us_last = 1;				// beep
+		beeping = true;
 		const char* text2 = pgmstr_emptystr;
 		uint8_t mode = config.finish_beep_mode;
 		if (force_wait) {
@@ -279,21 +290,22 @@ namespace States {
 				text2 = pgmstr_press2continue;
 				break;
 			case 0:
-				us_last = 0;		// no beep
+				beeping = false;
 				break;
 			default:
 				break;
 		}
 		confirm.new_text(pgmstr_finished, text2);
 		hw.set_fans(fans_duties);
+		if (beeping) {
+			hw.beep();
+		}
 	}
 
 	Base* Confirm::loop() {
 		canceled = quit;
-		unsigned long us_now = millis();
-		if (us_last && us_now - us_last > 1000) {
+		if (beeping && Scheduler::due(Scheduler::TASK_BEEP)) {
 			hw.beep();
-			us_last = us_now;
 		}
 		if (canceled) {
 			return continue_to;
@@ -324,7 +336,6 @@ namespace States {
 		old_state = value_getter();
 		message = old_state ? message_on : message_off;
 		test_count = SWITCH_TEST_COUNT;
-		us_last = millis();
 	}
 
 	Base* Test_switch::loop() {
@@ -332,9 +343,7 @@ namespace States {
 			hw.beep();
 			return continue_to;
 		}
-		unsigned long us_now = millis();
-		if (us_now - us_last > 250) {
-			us_last = us_now;
+		if (Scheduler::due(Scheduler::TASK_SWITCH_TEST)) {
 			bool state = value_getter();
 			if (old_state != state) {
 				old_state = state;
@@ -485,6 +494,78 @@ namespace States {
 	}
 
 
+	// States::Fans_calibration
+	static_assert(FAN_CURVE_POINTS * FAN_CURVE_SETTLE < 60, "fans calibration doesn't fit in its minute");
+
+	Fans_calibration::Fans_calibration(
+		const char* title,
+		Base* continue_to)
+	:
+		Base(title, 0, fans_speed, continue_to, &test_time),
+		test_time(1),
+		fans_speed{MIN_FAN_SPEED, MIN_FAN_SPEED},
+		point(0),
+		old_seconds(0),
+		curve{},
+		draw(false)
+	{}
+
+	void Fans_calibration::start() {
+		fans_speed[0] = MIN_FAN_SPEED;
+		fans_speed[1] = MIN_FAN_SPEED;
+		point = 0;
+		old_seconds = 60 * test_time;
+		draw = true;
+		hw.set_fans_learning(true);
+		Base::start();
+	}
+
+	// open loop duty steps, fan speed is taken at the end of every step
+	Base* Fans_calibration::loop() {
+		if (canceled) {
+			hw.set_fans_learning(false);
+			return continue_to;
+		}
+		uint16_t seconds = timer.getCurrentTimeInSeconds();
+		if (seconds != old_seconds) {
+			old_seconds = seconds;
+			if (!((60 * test_time - seconds) % FAN_CURVE_SETTLE)) {
+				curve[0][point] = hw.fan_rpm[0];
+				curve[1][point] = hw.fan_rpm[1];
+				if (++point == FAN_CURVE_POINTS) {
+					hw.set_fans_learning(false);
+					for (uint8_t i = 0; i < 2; ++i) {
+						if (!hw.fan_curve_valid(curve[i])) {
+							error.new_text(i ? pgmstr_fan2_failure : pgmstr_fan1_failure, pgmstr_not_spinning);
+							return &error;
+						}
+					}
+					memcpy(config.fans_curve, curve, sizeof(config.fans_curve));
+					write_config(config.fans_curve, sizeof(config.fans_curve));
+					return continue_to;
+				}
+				fans_speed[0] = MIN_FAN_SPEED + point * FAN_CURVE_STEP;
+				fans_speed[1] = fans_speed[0];
+				hw.set_fans(fans_speed);
+				draw = true;
+			}
+		}
+		return Base::loop();
+	}
+
+	bool Fans_calibration::get_info1(char* buffer, uint8_t size) {
+		if (draw) {
+			buffer_init(buffer, size);
+			print(fans_speed[0]);
+			write('%');
+			get_position()[0] = char(0);
+			draw = false;
+			return true;
+		}
+		return false;
+	}
+
+
 	// States::Test_uvled
 	Test_uvled::Test_uvled(
 		const char* title,
@@ -493,7 +574,7 @@ namespace States {
 	:
 		Base(title, STATE_OPTION_UVLED | STATE_OPTION_UVLED_TEMP, fans_duties, continue_to, &test_time),
 		test_time(UVLED_TEST_TIME),
-		old_uvled_temp(0.0)
+		old_uvled_temp(0)
 	{}
 
 	void Test_uvled::start() {
@@ -503,7 +584,7 @@ namespace States {
 
 	Base* Test_uvled::loop() {
 		uint16_t seconds = timer.getCurrentTimeInSeconds() - 1;
-		if (!seconds && old_uvled_temp + UVLED_TEST_GAIN > hw.uvled_temp_celsius) {
+		if (!seconds && old_uvled_temp + UVLED_TEST_GAIN * 10 > hw.uvled_temp_celsius) {
 			error.new_text(pgmstr_led_failure, pgmstr_nopower_error);
 			return &error;
 		}
@@ -519,7 +600,7 @@ namespace States {
 	:
 		Base(title, STATE_OPTION_HEATER | STATE_OPTION_CHAMB_TEMP, fans_duties, continue_to, &test_time),
 		test_time(HEATER_TEST_TIME),
-		old_chamb_temp(0.0),
+		old_chamb_temp(0),
 		old_seconds(0),
 		draw(false)
 	{}
@@ -531,14 +612,14 @@ namespace States {
 	}
 
 	Base* Test_heater::loop() {
-		if (old_chamb_temp < 0.0 || hw.chamber_temp_celsius < 0.0) {
+		if (old_chamb_temp < 0 || hw.chamber_temp_celsius < 0) {
 			error.new_text(pgmstr_heater_failure, pgmstr_read_temp_error);
 			return &error;
 		}
 		uint16_t seconds = timer.getCurrentTimeInSeconds() - 1;
 #ifdef CW1S
 		// TODO this is not working on CW1S
-		if (!seconds && old_chamb_temp + HEATER_TEST_GAIN > hw.chamber_temp_celsius) {
+		if (!seconds && old_chamb_temp + HEATER_TEST_GAIN * 10 > hw.chamber_temp_celsius) {
 			error.new_text(pgmstr_heater_failure, pgmstr_nopower_error);
 			return &error;
 		}
@@ -567,4 +648,123 @@ namespace States {
 		return false;
 	}
 
+
+#ifdef CW1S
+	// States::Heater_autotune
+	Heater_autotune::Heater_autotune(
+		const char* title,
+		Base* continue_to)
+	:
+		Base(title, STATE_OPTION_TIMER_UP | STATE_OPTION_HEATER | STATE_OPTION_CHAMB_TEMP, config.fans_drying_speed, continue_to, &test_time),
+		test_time(HEATER_AUTOTUNE_TIME),
+		cycles(0),
+		setpoint(0),
+		temp_min(0),
+		temp_max(0),
+		bias(0),
+		amplitude(0),
+		kp(0),
+		ki(0),
+		kd(0),
+		us_high(0),
+		us_switch(0),
+		heating(false),
+		draw(false)
+	{}
+
+	void Heater_autotune::start() {
+		setpoint = config.SI_unit_system ? config.target_temp * 10 : fahrenheit2celsius(config.target_temp * 10);
+		temp_min = temp_max = setpoint;
+		bias = amplitude = 500;
+		kp = ki = kd = 0;
+		cycles = 0;
+		heating = true;
+		draw = true;
+		us_switch = millis();
+		Base::start();
+	}
+
+	// relay oscillation around setpoint, relay bias follows the heat loss so both half periods are equal
+	Base* Heater_autotune::loop() {
+		if (canceled) {
+			return continue_to;
+		}
+		if (timer.isCounterCompleted()) {
+			error.new_text(pgmstr_heater_autotune, pgmstr_autotune_failed);
+			return &error;
+		}
+		if (!is_paused()) {
+			int16_t temp = hw.chamber_temp_celsius;
+			unsigned long us_now = millis();
+			if (temp > temp_max) {
+				temp_max = temp;
+			}
+			if (temp < temp_min) {
+				temp_min = temp;
+			}
+			if (heating && temp > setpoint + HEATER_AUTOTUNE_HYST) {
+				heating = false;
+				us_high = us_now - us_switch;
+				us_switch = us_now;
+				temp_max = temp;
+			} else if (!heating && temp < setpoint - HEATER_AUTOTUNE_HYST) {
+				heating = true;
+				unsigned long us_low = us_now - us_switch;
+				us_switch = us_now;
+				if (cycles) {
+					if (cycles > 1) {
+						tune(us_high + us_low);
+					}
+					int32_t shift = (int32_t)amplitude * ((int32_t)us_high - (int32_t)us_low) / (int32_t)(us_high + us_low);
+					bias = constrain((int16_t)bias + shift, 20, 980);
+					amplitude = bias > 500 ? 1000 - bias : bias;
+				}
+				temp_min = temp;
+				if (++cycles > HEATER_AUTOTUNE_CYCLES) {
+					if (kp > HEATER_PID_GAIN_MAX || ki > HEATER_PID_GAIN_MAX || kd > HEATER_PID_GAIN_MAX) {
+						// stored gains stay as they were
+						error.new_text(pgmstr_heater_autotune, pgmstr_gains_out_of_range);
+						return &error;
+					}
+					config.heater_pid_kp = kp;
+					config.heater_pid_ki = ki;
+					config.heater_pid_kd = kd;
+					write_config(&config.heater_pid_kp, sizeof(config.heater_pid_kp));
+					write_config(&config.heater_pid_ki, sizeof(config.heater_pid_ki));
+					write_config(&config.heater_pid_kd, sizeof(config.heater_pid_kd));
+					return continue_to;
+				}
+				draw = true;
+			}
+			hw.set_heater_open_loop(heating ? bias + amplitude : bias - amplitude);
+		}
+		return Base::loop();
+	}
+
+	// Ziegler-Nichols from ultimate gain Ku = 4 * amplitude / (pi * a) and period Tu,
+	// Kp = 0.6 * Ku, Ti = Tu / 2, Td = Tu / 8 in HEATER_PID_* units
+	void Heater_autotune::tune(unsigned long tu) {
+		uint16_t swing = temp_max - temp_min;	// 2 * a
+		if (swing < 1) {
+			swing = 1;
+		}
+		kp = 391UL * amplitude / swing;
+		ki = kp * 2 * HEATER_PID_PERIOD / tu;
+		kd = kp * (tu / HEATER_PID_PERIOD) / 8;
+	}
+
+	bool Heater_autotune::get_info2(char* buffer, uint8_t size) {
+		if (draw) {
+			buffer_init(buffer, size);
+			print(cycles, 1);
+			write('/');
+			print((uint8_t)HEATER_AUTOTUNE_CYCLES, 1);
+			get_position()[0] = char(0);
+			draw = false;
+			return true;
+		}
+		return false;
+	}
+#endif
+
 }
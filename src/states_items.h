@@ -44,7 +44,7 @@ namespace States {
 		const char* get_title();
 		const char* get_message();
 		uint16_t get_time();
-		float get_temperature();
+		int16_t get_temperature();
 		const char* decrease_time();
 		const char* increase_time();
 		bool is_paused();
@@ -89,6 +89,7 @@ namespace States {
 	private:
 		bool force_wait;
 		bool quit;
+		bool beeping;	// beep every TASK_BEEP
 	};
 
 
@@ -150,6 +151,25 @@ namespace States {
 	};
 
 
+	// States::Fans_calibration
+	class Fans_calibration : public Base, public SimplePrint {
+	public:
+		Fans_calibration(
+			const char* title,
+			Base* continue_to);
+		void start();
+		Base* loop();
+		bool get_info1(char* buffer, uint8_t size);
+	private:
+		uint8_t test_time;
+		uint8_t fans_speed[2];
+		uint8_t point;
+		uint16_t old_seconds;
+		uint16_t curve[2][FAN_CURVE_POINTS];	// copied to config when both fans pass
+		bool draw;
+	};
+
+
 	// States::Test_uvled
 	class Test_uvled : public Base {
 	public:
@@ -161,7 +181,7 @@ namespace States {
 		Base* loop();
 	private:
 		uint8_t test_time;
-		float old_uvled_temp;
+		int16_t old_uvled_temp;
 	};
 
 
@@ -177,9 +197,39 @@ namespace States {
 		bool get_info2(char* buffer, uint8_t size);
 	private:
 		uint8_t test_time;
-		float old_chamb_temp;
+		int16_t old_chamb_temp;
 		uint16_t old_seconds;
 		bool draw;
 	};
 
+
+#ifdef CW1S
+	// States::Heater_autotune
+	class Heater_autotune : public Base, public SimplePrint {
+	public:
+		Heater_autotune(
+			const char* title,
+			Base* continue_to);
+		void start();
+		Base* loop();
+		bool get_info2(char* buffer, uint8_t size);
+	private:
+		void tune(unsigned long tu);
+		uint8_t test_time;
+		uint8_t cycles;
+		int16_t setpoint;
+		int16_t temp_min;
+		int16_t temp_max;
+		uint16_t bias;
+		uint16_t amplitude;
+		uint32_t kp;
+		uint32_t ki;
+		uint32_t kd;
+		unsigned long us_high;
+		unsigned long us_switch;
+		bool heating;
+		bool draw;
+	};
+#endif
+
 }
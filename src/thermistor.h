@@ -0,0 +1,91 @@
+#pragma once
+
+// Thermistor lookup. The ADC value tables are turned into an ADC-indexed
+// form at compile time: every cell of 1 << THERM_CELL_SHIFT ADC values points
+// to its first table segment and every segment carries its slope, so a lookup
+// is a couple of compares, one multiply and a shift instead of a binary search
+// and a division. Results are the same as interpolate_i16_ylin_P() (checked
+// by static_assert below and by the "thermistor" host bench scenario).
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#define THERM_TABLE_SIZE	34
+#define THERM_TEMP_MAX		1250	// deci-celsius at the first table entry
+#define THERM_TEMP_STEP		50		// deci-celsius between table entries (decreasing)
+#define THERM_ADC_RANGE		1024
+#define THERM_CELL_SHIFT	4
+#define THERM_SLOPE_SHIFT	11		// smallest shift giving exact results for both tables
+#define THERM_MAX_STEPS		3		// segment boundaries crossed within one cell
+
+// ADC value of every THERM_TEMP_STEP from THERM_TEMP_MAX down to -40 C
+constexpr int16_t chamber_temp_table_raw[THERM_TABLE_SIZE] = {
+	25, 29, 34, 40, 46, 54, 64, 75, 88, 105, 124, 146, 173, 204, 241, 282, 330, 382, 439, 500,
+	563, 625, 687, 744, 796, 842, 882, 915, 941, 963, 979, 992, 1001, 1008
+};
+
+constexpr int16_t uvled_temp_table_raw[THERM_TABLE_SIZE] = {
+	73, 83, 95, 109, 125, 144, 165, 189, 217, 248, 284, 323, 366, 412, 462, 514, 567, 620, 673, 723,
+	770, 813, 851, 885, 913, 937, 957, 973, 986, 995, 1003, 1009, 1013, 1016
+};
+
+struct thermistor_t {
+	uint8_t cell_segment[THERM_ADC_RANGE >> THERM_CELL_SHIFT];
+	int16_t raw[THERM_TABLE_SIZE];
+	uint16_t slope[THERM_TABLE_SIZE - 1];	// THERM_TEMP_STEP / segment width, rounded up
+
+	constexpr thermistor_t(const int16_t (&table)[THERM_TABLE_SIZE]) : cell_segment(), raw(), slope() {
+		for (uint8_t i = 0; i < THERM_TABLE_SIZE; ++i)
+			raw[i] = table[i];
+		for (uint8_t i = 0; i < THERM_TABLE_SIZE - 1; ++i) {
+			uint32_t width = raw[i + 1] - raw[i];
+			slope[i] = ((uint32_t)THERM_TEMP_STEP << THERM_SLOPE_SHIFT) / width
+				+ (((uint32_t)THERM_TEMP_STEP << THERM_SLOPE_SHIFT) % width != 0);
+		}
+		uint8_t segment = 0;
+		for (uint16_t cell = 0; cell < THERM_ADC_RANGE >> THERM_CELL_SHIFT; ++cell) {
+			while (segment < THERM_TABLE_SIZE - 2 && (int16_t)(cell << THERM_CELL_SHIFT) > raw[segment + 1])
+				++segment;
+			cell_segment[cell] = segment;
+		}
+	}
+
+	//! multiply and shift gives the same as the division in interpolate_i16_ylin_P()
+	constexpr bool exact() const {
+		for (uint8_t i = 0; i < THERM_TABLE_SIZE - 1; ++i) {
+			uint16_t width = raw[i + 1] - raw[i];
+			for (uint16_t d = 0; d <= width; ++d) {
+				if ((((uint32_t)d * slope[i]) >> THERM_SLOPE_SHIFT) != (uint32_t)d * THERM_TEMP_STEP / width)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	constexpr uint8_t max_steps() const {
+		uint8_t steps = 0;
+		for (uint16_t cell = 0; cell < THERM_ADC_RANGE >> THERM_CELL_SHIFT; ++cell) {
+			uint8_t segment = cell_segment[cell];
+			uint8_t last = segment;
+			int16_t adc_last = ((cell + 1) << THERM_CELL_SHIFT) - 1;
+			while (last < THERM_TABLE_SIZE - 2 && adc_last > raw[last + 1])
+				++last;
+			if (last - segment > steps)
+				steps = last - segment;
+		}
+		return steps;
+	}
+};
+
+//! @return deci-celsius for averaged ADC value, table is in PROGMEM
+inline int16_t thermistor_celsius(const thermistor_t* table, int16_t adc) {
+	if (adc <= (int16_t)pgm_read_word(&table->raw[0]))
+		return THERM_TEMP_MAX;
+	if (adc >= (int16_t)pgm_read_word(&table->raw[THERM_TABLE_SIZE - 1]))
+		return THERM_TEMP_MAX - (THERM_TABLE_SIZE - 1) * THERM_TEMP_STEP;
+	uint8_t i = pgm_read_byte(&table->cell_segment[adc >> THERM_CELL_SHIFT]);
+	while (adc > (int16_t)pgm_read_word(&table->raw[i + 1]))
+		++i;
+	uint8_t d = adc - pgm_read_word(&table->raw[i]);
+	return THERM_TEMP_MAX - i * THERM_TEMP_STEP - (int16_t)(((uint32_t)d * pgm_read_word(&table->slope[i])) >> THERM_SLOPE_SHIFT);
+}
@@ -7,175 +7,179 @@
 namespace UI {
 
 	/*** menu definitions ***/
-	Base back(pgmstr_back, BACK_CHAR);
-	Base stop(pgmstr_stop, STOP_CHAR);
-
-	// move all following definitions to init() to save RAM instead of PROGMEM
+	// items are constant, referenced items have to be defined first
+	constexpr item_t back PROGMEM = Back(pgmstr_back);
+	constexpr item_t stop PROGMEM = Stop(pgmstr_stop);
 
 	// run time menu
-	Minutes curing_run_time(pgmstr_curing_run_time, config.curing_run_time, MAX_CURING_RUNTIME);
-	Minutes drying_run_time(pgmstr_drying_run_time, config.drying_run_time, MAX_DRYING_RUNTIME);
-	Minutes washing_run_time(pgmstr_washing_run_time, config.washing_run_time, MAX_WASHING_RUNTIME);
-	Minutes resin_preheat_run_time(pgmstr_resin_preheat_time, config.resin_preheat_run_time, MAX_PREHEAT_RUNTIME);
-	Base* const run_time_items[] PROGMEM = {&back, &curing_run_time, &drying_run_time, &washing_run_time, &resin_preheat_run_time};
-	Menu run_time_menu(pgmstr_run_time, run_time_items, COUNT_ITEMS(run_time_items));
+	constexpr item_t curing_run_time PROGMEM = Minutes(pgmstr_curing_run_time, config.curing_run_time, MAX_CURING_RUNTIME);
+	constexpr item_t drying_run_time PROGMEM = Minutes(pgmstr_drying_run_time, config.drying_run_time, MAX_DRYING_RUNTIME);
+	constexpr item_t washing_run_time PROGMEM = Minutes(pgmstr_washing_run_time, config.washing_run_time, MAX_WASHING_RUNTIME);
+	constexpr item_t resin_preheat_run_time PROGMEM = Minutes(pgmstr_resin_preheat_time, config.resin_preheat_run_time, MAX_PREHEAT_RUNTIME);
+	constexpr const item_t* run_time_items[] PROGMEM = {&back, &curing_run_time, &drying_run_time, &washing_run_time, &resin_preheat_run_time};
+	constexpr item_t run_time_menu PROGMEM = Menu(pgmstr_run_time, run_time_items, COUNT_ITEMS(run_time_items));
 
 	// speed menu
-	X_of_ten curing_speed(pgmstr_curing_speed, config.curing_speed);
-	X_of_ten washing_speed(pgmstr_washing_speed, config.washing_speed);
-	Base* const speed_items[] PROGMEM = {&back, &curing_speed, &washing_speed};
-	Menu speed_menu(pgmstr_rotation_speed, speed_items, COUNT_ITEMS(speed_items));
+	constexpr item_t curing_speed PROGMEM = X_of_ten(pgmstr_curing_speed, config.curing_speed);
+	constexpr item_t washing_speed PROGMEM = X_of_ten(pgmstr_washing_speed, config.washing_speed);
+	constexpr const item_t* speed_items[] PROGMEM = {&back, &curing_speed, &washing_speed};
+	constexpr item_t speed_menu PROGMEM = Menu(pgmstr_rotation_speed, speed_items, COUNT_ITEMS(speed_items));
 
 	// temperatore menu
-	Bool heat_to_target_temp(pgmstr_warmup, config.heat_to_target_temp);
-	Temperature target_temp(pgmstr_drying_warmup_temp, config.target_temp);
-	Temperature resin_target_temp(pgmstr_resin_preheat_temp, config.resin_target_temp);
-	Temperature* const SI_changed[] PROGMEM = {&target_temp, &resin_target_temp};
-	SI_switch SI_unit_system(pgmstr_units, config.SI_unit_system, SI_changed, COUNT_ITEMS(SI_changed));
-	Base* const temperature_items[] PROGMEM = {&back, &heat_to_target_temp, &target_temp, &resin_target_temp, &SI_unit_system};
-	Menu temperature_menu(pgmstr_temperatures, temperature_items, COUNT_ITEMS(temperature_items));
+	constexpr item_t heat_to_target_temp PROGMEM = Bool(pgmstr_warmup, config.heat_to_target_temp);
+	constexpr item_t target_temp PROGMEM = Temperature(pgmstr_drying_warmup_temp, config.target_temp);
+	constexpr item_t resin_target_temp PROGMEM = Temperature(pgmstr_resin_preheat_temp, config.resin_target_temp);
+	constexpr const item_t* SI_changed[] PROGMEM = {&target_temp, &resin_target_temp};
+	constexpr item_t SI_unit_system PROGMEM = SI_switch(pgmstr_units, config.SI_unit_system, SI_changed, COUNT_ITEMS(SI_changed));
+	constexpr const item_t* temperature_items[] PROGMEM = {&back, &heat_to_target_temp, &target_temp, &resin_target_temp, &SI_unit_system};
+	constexpr item_t temperature_menu PROGMEM = Menu(pgmstr_temperatures, temperature_items, COUNT_ITEMS(temperature_items));
 
 	// sound menu
-	Bool sound_response(pgmstr_control_echo, config.sound_response);
-	const char* const finish_beep_options[] PROGMEM = {pgmstr_none, pgmstr_once, pgmstr_continuous};
-	Option finish_beep(pgmstr_finish_beep, config.finish_beep_mode, finish_beep_options, COUNT_ITEMS(finish_beep_options));
-	Base* const sound_items[] PROGMEM = {&back, &sound_response, &finish_beep};
-	Menu sound_menu(pgmstr_sound, sound_items, COUNT_ITEMS(sound_items));
+	constexpr item_t sound_response PROGMEM = Bool(pgmstr_control_echo, config.sound_response);
+	constexpr const char* finish_beep_options[] PROGMEM = {pgmstr_none, pgmstr_once, pgmstr_continuous};
+	constexpr item_t finish_beep PROGMEM = Option(pgmstr_finish_beep, config.finish_beep_mode, finish_beep_options, COUNT_ITEMS(finish_beep_options));
+	constexpr const item_t* sound_items[] PROGMEM = {&back, &sound_response, &finish_beep};
+	constexpr item_t sound_menu PROGMEM = Menu(pgmstr_sound, sound_items, COUNT_ITEMS(sound_items));
 
 	// fans curing speed
-	Percent fan1_curing_speed(pgmstr_fan1_curing_speed, config.fans_curing_speed[0], MIN_FAN_SPEED);
-	Percent fan2_curing_speed(pgmstr_fan2_curing_speed, config.fans_curing_speed[1], MIN_FAN_SPEED);
-	Base* const fans_curing_speed[] PROGMEM = {&back, &fan1_curing_speed, &fan2_curing_speed};
-	Menu fans_curing_menu(pgmstr_fans_curing, fans_curing_speed, COUNT_ITEMS(fans_curing_speed));
+	constexpr item_t fan1_curing_speed PROGMEM = Percent(pgmstr_fan1_curing_speed, config.fans_curing_speed[0], MIN_FAN_SPEED);
+	constexpr item_t fan2_curing_speed PROGMEM = Percent(pgmstr_fan2_curing_speed, config.fans_curing_speed[1], MIN_FAN_SPEED);
+	constexpr const item_t* fans_curing_speed[] PROGMEM = {&back, &fan1_curing_speed, &fan2_curing_speed};
+	constexpr item_t fans_curing_menu PROGMEM = Menu(pgmstr_fans_curing, fans_curing_speed, COUNT_ITEMS(fans_curing_speed));
 
 	// fans drying speed
-	Percent fan2_drying_speed(pgmstr_fan2_drying_speed, config.fans_drying_speed[1], MIN_FAN_SPEED);
+	constexpr item_t fan2_drying_speed PROGMEM = Percent(pgmstr_fan2_drying_speed, config.fans_drying_speed[1], MIN_FAN_SPEED);
 	#ifdef CW1S
-		Base* const fans_drying_speed[] PROGMEM = {&back, &fan2_drying_speed};
+		constexpr const item_t* fans_drying_speed[] PROGMEM = {&back, &fan2_drying_speed};
 	#else
-		Percent fan1_drying_speed(pgmstr_fan1_drying_speed, config.fans_drying_speed[0], MIN_FAN_SPEED);
-		Base* const fans_drying_speed[] PROGMEM = {&back, &fan1_drying_speed, &fan2_drying_speed};
+		constexpr item_t fan1_drying_speed PROGMEM = Percent(pgmstr_fan1_drying_speed, config.fans_drying_speed[0], MIN_FAN_SPEED);
+		constexpr const item_t* fans_drying_speed[] PROGMEM = {&back, &fan1_drying_speed, &fan2_drying_speed};
 	#endif
-	Menu fans_drying_menu(pgmstr_fans_drying, fans_drying_speed, COUNT_ITEMS(fans_drying_speed));
+	constexpr item_t fans_drying_menu PROGMEM = Menu(pgmstr_fans_drying, fans_drying_speed, COUNT_ITEMS(fans_drying_speed));
 
 	// fans washing speed
-	Percent fan2_washing_speed(pgmstr_fan2_washing_speed, config.fans_washing_speed[1], MIN_FAN_SPEED);
+	constexpr item_t fan2_washing_speed PROGMEM = Percent(pgmstr_fan2_washing_speed, config.fans_washing_speed[1], MIN_FAN_SPEED);
 	#ifdef CW1S
-		Base* const fans_washing_speed[] PROGMEM = {&back, &fan2_washing_speed};
+		constexpr const item_t* fans_washing_speed[] PROGMEM = {&back, &fan2_washing_speed};
 	#else
-		Percent fan1_washing_speed(pgmstr_fan1_washing_speed, config.fans_washing_speed[0], MIN_FAN_SPEED);
-		Base* const fans_washing_speed[] PROGMEM = {&back, &fan1_washing_speed, &fan2_washing_speed};
+		constexpr item_t fan1_washing_speed PROGMEM = Percent(pgmstr_fan1_washing_speed, config.fans_washing_speed[0], MIN_FAN_SPEED);
+		constexpr const item_t* fans_washing_speed[] PROGMEM = {&back, &fan1_washing_speed, &fan2_washing_speed};
 	#endif
-	Menu fans_washing_menu(pgmstr_fans_washing, fans_washing_speed, COUNT_ITEMS(fans_washing_speed));
+	constexpr item_t fans_washing_menu PROGMEM = Menu(pgmstr_fans_washing, fans_washing_speed, COUNT_ITEMS(fans_washing_speed));
 
 	// fans menu speed
-	Percent_with_action fan2_menu_speed(pgmstr_fan2_menu_speed, config.fans_menu_speed[1], MIN_FAN_SPEED, hw.set_fan2_duty);
+	constexpr item_t fan2_menu_speed PROGMEM = Percent(pgmstr_fan2_menu_speed, config.fans_menu_speed[1], MIN_FAN_SPEED, hw.set_fan2_duty);
 	#ifdef CW1S
-		Base* const fans_menu_speed[] PROGMEM = {&back, &fan2_menu_speed};
+		constexpr const item_t* fans_menu_speed[] PROGMEM = {&back, &fan2_menu_speed};
 	#else
-		Percent_with_action fan1_menu_speed(pgmstr_fan1_menu_speed, config.fans_menu_speed[0], MIN_FAN_SPEED, hw.set_fan1_duty);
-		Base* const fans_menu_speed[] PROGMEM = {&back, &fan1_menu_speed, &fan2_menu_speed};
+		constexpr item_t fan1_menu_speed PROGMEM = Percent(pgmstr_fan1_menu_speed, config.fans_menu_speed[0], MIN_FAN_SPEED, hw.set_fan1_duty);
+		constexpr const item_t* fans_menu_speed[] PROGMEM = {&back, &fan1_menu_speed, &fan2_menu_speed};
 	#endif
-	Menu fans_menu_menu(pgmstr_fans_menu, fans_menu_speed, COUNT_ITEMS(fans_menu_speed));
+	constexpr item_t fans_menu_menu PROGMEM = Menu(pgmstr_fans_menu, fans_menu_speed, COUNT_ITEMS(fans_menu_speed));
 
 	// fans menu
-	Base* const fans_items[] PROGMEM = {&back, &fans_curing_menu, &fans_drying_menu, &fans_washing_menu, &fans_menu_menu};
-	Menu fans_menu(pgmstr_fans, fans_items, COUNT_ITEMS(fans_items));
+	constexpr item_t fans_rpm_control PROGMEM = Bool(pgmstr_rpm_control, config.fans_rpm_control);
+	constexpr item_t fans_calibration PROGMEM = State(pgmstr_fans_calibration, &States::fans_calibration);
+	constexpr const item_t* fans_items[] PROGMEM = {&back, &fans_curing_menu, &fans_drying_menu, &fans_washing_menu, &fans_menu_menu, &fans_rpm_control, &fans_calibration};
+	constexpr item_t fans_menu PROGMEM = Menu(pgmstr_fans, fans_items, COUNT_ITEMS(fans_items));
+
+	// hw menu
+	constexpr item_t fan1_rpm PROGMEM = Live_value(pgmstr_fan1_rpm, hw.fan_rpm[0]);
+	constexpr item_t fan2_rpm PROGMEM = Live_value(pgmstr_fan2_rpm, hw.fan_rpm[1]);
+	constexpr item_t chamber_temp PROGMEM = Live_value(pgmstr_chamber_temp, hw.chamber_temp);
+	constexpr item_t uvled_temp PROGMEM = Live_value(pgmstr_uvled_temp, hw.uvled_temp);
+	#ifdef CW1S
+		constexpr const item_t* hw_items[] PROGMEM = {&back, &fan1_rpm, &fan2_rpm, &chamber_temp, &uvled_temp};
+	#else
+		constexpr item_t fan3_rpm PROGMEM = Live_value(pgmstr_fan3_rpm, hw.fan_rpm[2]);
+		constexpr const item_t* hw_items[] PROGMEM = {&back, &fan1_rpm, &fan2_rpm, &fan3_rpm, &chamber_temp, &uvled_temp};
+	#endif
+	constexpr item_t hw_menu PROGMEM = Menu_self_redraw(pgmstr_emptystr, hw_items, COUNT_ITEMS(hw_items));
 
 	// info menu
-	SN serial_number(pgmstr_sn);
-	Text fw_version(pgmstr_fw_version);
-	Text build_nr(pgmstr_build_nr);
-	Text fw_hash(pgmstr_fw_hash);
+	constexpr item_t serial_number PROGMEM = SN(pgmstr_sn);
+	constexpr item_t fw_version PROGMEM = Text(pgmstr_fw_version);
+	constexpr item_t build_nr PROGMEM = Text(pgmstr_build_nr);
+	constexpr item_t fw_hash PROGMEM = Text(pgmstr_fw_hash);
 #if FW_LOCAL_CHANGES
-	Text workspace_dirty(pgmstr_workspace_dirty);
-	Base* const info_items[] PROGMEM = {&back, &serial_number, &fw_version, &build_nr, &fw_hash, &workspace_dirty};
+	constexpr item_t workspace_dirty PROGMEM = Text(pgmstr_workspace_dirty);
+	constexpr const item_t* info_items[] PROGMEM = {&back, &serial_number, &fw_version, &build_nr, &fw_hash, &workspace_dirty};
 #else
-	Base* const info_items[] PROGMEM = {&back, &serial_number, &fw_version, &build_nr, &fw_hash};
+	constexpr const item_t* info_items[] PROGMEM = {&back, &serial_number, &fw_version, &build_nr, &fw_hash};
 #endif
-	Menu info_menu(pgmstr_information, info_items, COUNT_ITEMS(info_items));
+	constexpr item_t info_menu PROGMEM = Menu(pgmstr_information, info_items, COUNT_ITEMS(info_items), &hw_menu);
+
+	// advanced menu
+	constexpr item_t led_intensity PROGMEM = Percent(pgmstr_led_intensity, config.led_intensity, MIN_LED_INTENSITY);
+	constexpr item_t cooldown PROGMEM = State(pgmstr_cooldown, &States::cooldown, &hw_menu);
+	constexpr item_t selftest PROGMEM = State(pgmstr_selftest, &States::selftest_cover);
+	#ifdef CW1S
+		constexpr item_t heater_autotune PROGMEM = State(pgmstr_heater_autotune, &States::heater_autotune);
+		constexpr const item_t* advanced_items[] PROGMEM = {&back, &fans_menu, &led_intensity, &cooldown, &selftest, &heater_autotune};
+	#else
+		constexpr const item_t* advanced_items[] PROGMEM = {&back, &fans_menu, &led_intensity, &cooldown, &selftest};
+	#endif
+	constexpr item_t advanced_menu PROGMEM = Menu(pgmstr_emptystr, advanced_items, COUNT_ITEMS(advanced_items));
 
 	// config menu
-	const char* const curing_machine_mode_options[] PROGMEM = {pgmstr_drying_curing, pgmstr_curing, pgmstr_drying};
-	Option curing_machine_mode(pgmstr_run_mode, config.curing_machine_mode, curing_machine_mode_options, COUNT_ITEMS(curing_machine_mode_options));
-	Percent led_intensity(pgmstr_led_intensity, config.led_intensity, MIN_LED_INTENSITY);
-	Percent_with_action lcd_brightness(pgmstr_lcd_brightness, config.lcd_brightness, MIN_LCD_BRIGHTNESS, lcd.setBrightness);
-	Base* const config_items[] PROGMEM = {&back, &speed_menu, &curing_machine_mode, &temperature_menu, &sound_menu, &lcd_brightness, &info_menu};
-	Menu config_menu(pgmstr_settings, config_items, COUNT_ITEMS(config_items));
+	constexpr const char* curing_machine_mode_options[] PROGMEM = {pgmstr_drying_curing, pgmstr_curing, pgmstr_drying};
+	constexpr item_t curing_machine_mode PROGMEM = Option(pgmstr_run_mode, config.curing_machine_mode, curing_machine_mode_options, COUNT_ITEMS(curing_machine_mode_options));
+	constexpr item_t lcd_brightness PROGMEM = Percent(pgmstr_lcd_brightness, config.lcd_brightness, MIN_LCD_BRIGHTNESS, lcd.setBrightness);
+	constexpr const item_t* config_items[] PROGMEM = {&back, &speed_menu, &curing_machine_mode, &temperature_menu, &sound_menu, &lcd_brightness, &info_menu};
+	constexpr item_t config_menu PROGMEM = Menu(pgmstr_settings, config_items, COUNT_ITEMS(config_items), &advanced_menu);
 
 	// run menu
-	Pause pause(&back);
-	Base* const run_items[] PROGMEM = {&pause, &stop, &back};
-	Menu run_menu(pgmstr_emptystr, run_items, COUNT_ITEMS(run_items));
+	constexpr item_t pause PROGMEM = Pause(&back);
+	constexpr const item_t* run_items[] PROGMEM = {&pause, &stop, &back};
+	constexpr item_t run_menu PROGMEM = Menu(pgmstr_emptystr, run_items, COUNT_ITEMS(run_items), &hw_menu);
 
 	// hold platform function
-	Base* const hold_platform_items[] PROGMEM = {&back};
-	Hold_platform hold_platform_menu(pgmstr_hold_platform, hold_platform_items, COUNT_ITEMS(hold_platform_items));
+	constexpr const item_t* hold_platform_items[] PROGMEM = {&back};
+	constexpr item_t hold_platform_menu PROGMEM = Hold_platform(pgmstr_hold_platform, hold_platform_items, COUNT_ITEMS(hold_platform_items));
 
 	// home menu
-	Do_it do_it(config.curing_machine_mode, &run_menu);
-	State resin_preheat(pgmstr_resin_preheat, &States::warmup_resin, &run_menu);
-	Base* const home_items[] PROGMEM = {&do_it, &resin_preheat, &run_time_menu, &hold_platform_menu, &config_menu};
-	Menu home_menu(pgmstr_emptystr, home_items, COUNT_ITEMS(home_items));
-
-	// hw menu
-	Live_value<uint16_t> fan1_rpm(pgmstr_fan1_rpm, hw.fan_rpm[0]);
-	Live_value<uint16_t> fan2_rpm(pgmstr_fan2_rpm, hw.fan_rpm[1]);
-	Live_value<float> chamber_temp(pgmstr_chamber_temp, hw.chamber_temp);
-	Live_value<float> uvled_temp(pgmstr_uvled_temp, hw.uvled_temp);
-	#ifdef CW1S
-		Base* const hw_items[] PROGMEM = {&back, &fan1_rpm, &fan2_rpm, &chamber_temp, &uvled_temp};
-	#else
-		Live_value<uint16_t> fan3_rpm(pgmstr_fan3_rpm, hw.fan_rpm[2]);
-		Base* const hw_items[] PROGMEM = {&back, &fan1_rpm, &fan2_rpm, &fan3_rpm, &chamber_temp, &uvled_temp};
-	#endif
-	Menu_self_redraw hw_menu(pgmstr_emptystr, hw_items, COUNT_ITEMS(hw_items), MENU_REDRAW_US);
-
-	// advanced menu
-	State cooldown(pgmstr_cooldown, &States::cooldown, &hw_menu);
-	State selftest(pgmstr_selftest, &States::selftest_cover, nullptr);
-	Base* const advanced_items[] PROGMEM = {&back, &fans_menu, &led_intensity, &cooldown, &selftest};
-	Menu advanced_menu(pgmstr_emptystr, advanced_items, COUNT_ITEMS(advanced_items));
+	constexpr item_t do_it PROGMEM = Do_it(config.curing_machine_mode, &run_menu);
+	constexpr item_t resin_preheat PROGMEM = State(pgmstr_resin_preheat, &States::warmup_resin, &run_menu);
+	constexpr const item_t* home_items[] PROGMEM = {&do_it, &resin_preheat, &run_time_menu, &hold_platform_menu, &config_menu};
+	constexpr item_t home_menu PROGMEM = Menu(pgmstr_emptystr, home_items, COUNT_ITEMS(home_items), &curing_machine_mode);
 
 
 	/*** menu data ***/
-	Base* menu_stack[MAX_MENU_DEPTH];
+	const item_t* menu_stack[MAX_MENU_DEPTH];
+	menu_position_t position_stack[MAX_MENU_DEPTH];
 	uint8_t menu_depth = 0;
-	Base* active_menu = &home_menu;
+	const item_t* active_menu = &home_menu;
 
 	void init() {
-		for (uint8_t i = 0; i < COUNT_ITEMS(SI_changed); ++i) {
-			SI_changed[i]->init(config.SI_unit_system);
-		}
-		home_menu.set_long_press_ui_item(&curing_machine_mode);
-		info_menu.set_long_press_ui_item(&hw_menu);
-		run_menu.set_long_press_ui_item(&hw_menu);
-		config_menu.set_long_press_ui_item(&advanced_menu);
-		active_menu->invoke();
-		active_menu->show();
+		invoke(active_menu);
+		show(active_menu);
 	}
 
 	void loop(uint8_t events) {
-		active_menu->loop();
-		Base* new_menu = active_menu->process_events(events);
+		loop(active_menu);
+		const item_t* new_menu = process_events(active_menu, events);
 		if (new_menu == &stop || new_menu == &back || new_menu == active_menu || States::active_state->is_finished()) {
 			if (menu_depth) {
 				do {
-					active_menu->leave();
-					active_menu = menu_stack[--menu_depth];
+					leave(active_menu);
+					--menu_depth;
+					active_menu = menu_stack[menu_depth];
+					menu_position = position_stack[menu_depth];
 				} while (new_menu == &stop && menu_depth);
 				lcd.clear();
-				active_menu->show();
+				show(active_menu);
 			} else {
 				USB_PRINTLNP("ERROR: back at menu depth 0!");
 			}
 		} else if (new_menu) {
 			if (menu_depth < MAX_MENU_DEPTH) {
-				menu_stack[menu_depth++] = active_menu;
+				menu_stack[menu_depth] = active_menu;
+				position_stack[menu_depth] = menu_position;
+				++menu_depth;
 				active_menu = new_menu;
 				lcd.clear();
-				active_menu->invoke();
-				active_menu->show();
+				invoke(active_menu);
+				show(active_menu);
 			} else {
 				USB_PRINTLNP("ERROR: MAX_MENU_DEPTH reached!");
 			}
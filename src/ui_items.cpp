@@ -3,15 +3,58 @@
 #include "config.h"
 #include "ui_items.h"
 #include "states.h"
+#include "scheduler.h"
+#include "simple_print.h"
 
 namespace UI {
 
-	// UI::Base
-	Base::Base(const char* label, uint8_t last_char) :
-		label(label), last_char(last_char)
-	{}
+	menu_position_t menu_position = {0, 0};
+
+	// state screen of the active UI::State
+	static const char* old_title;
+	static const char* old_message;
+	static uint16_t old_time;
+	static unsigned long bound_us_last;
+	static uint8_t spin_count;
+
+	static void read_item(const item_t* from, item_t& item) {
+		memcpy_P(&item, from, sizeof(item_t));
+	}
+
+	static const item_t* read_child(const item_t& menu, uint8_t index) {
+		return (const item_t*)pgm_read_ptr(&((const item_t* const*)menu.items)[index]);
+	}
+
+	static bool is_menu(const item_t& item) {
+		return item.type == ITEM_MENU || item.type == ITEM_HOLD_PLATFORM || item.type == ITEM_SELF_REDRAW;
+	}
+
+	static uint8_t last_char(const item_t& item) {
+		switch (item.type) {
+			case ITEM_BACK:
+				return BACK_CHAR;
+			case ITEM_STOP:
+				return STOP_CHAR;
+			case ITEM_TEXT:
+			case ITEM_SN:
+			case ITEM_LIVE_U16:
+			case ITEM_LIVE_I16:
+			case ITEM_BOOL:
+			case ITEM_SI_SWITCH:
+			case ITEM_PAUSE:
+				return 0;
+			case ITEM_STATE:
+			case ITEM_DO_IT:
+				return PLAY_CHAR;
+			default:
+				return RIGHT_CHAR;
+		}
+	}
+
 
-	char* Base::get_menu_label(char* buffer, uint8_t buffer_size) {
+	/*** labels ***/
+
+	static char* print_label(const char* label, uint8_t last_char, char* buffer, uint8_t buffer_size) {
 		buffer[--buffer_size] = char(0);	// end of text
 		if (last_char)
 			buffer[--buffer_size] = last_char;
@@ -23,399 +66,339 @@ namespace UI {
 			++buffer;
 			c = pgm_read_byte(++from);
 		}
-	return buffer;
+		return buffer;
 	}
 
-	void Base::show() {
+	static const char* do_it_label(const item_t& item) {
+		if (hw.is_tank_inserted())
+			return pgmstr_washing;
+		switch (*(uint8_t*)item.value) {
+			case 2:
+				return pgmstr_drying;
+			case 1:
+				return pgmstr_curing;
+			default:
+				return pgmstr_drying_curing;
+		}
 	}
 
-	void Base::loop() {
+	char* get_menu_label(const item_t* from, char* buffer, uint8_t buffer_size) {
+		item_t item;
+		read_item(from, item);
+		const char* label = item.label;
+		if (item.type == ITEM_DO_IT)
+			label = do_it_label(item);
+		else if (item.type == ITEM_PAUSE)
+			label = States::active_state->is_paused() ? pgmstr_continue : pgmstr_pause;
+		char* end = print_label(label, last_char(item), buffer, buffer_size);
+		int8_t size = buffer + buffer_size - end;
+		switch (item.type) {
+			case ITEM_SN:
+				return strncpy_P(end, pgmstr_serial_number, size < SN_LENGTH ? size : SN_LENGTH);
+			case ITEM_LIVE_U16:
+			case ITEM_LIVE_I16: {
+				SimplePrint print;
+				print.buffer_init(end, size < 0 ? 0 : size);
+				if (item.type == ITEM_LIVE_U16)
+					print.print(*(uint16_t*)item.value);
+				else
+					print.print(*(int16_t*)item.value);
+				return print.get_position();
+			}
+			case ITEM_BOOL:
+			case ITEM_SI_SWITCH: {
+				const char* from_text;
+				if (item.type == ITEM_BOOL)
+					from_text = *(uint8_t*)item.value ? pgmstr_on : pgmstr_off;
+				else
+					from_text = *(uint8_t*)item.value ? pgmstr_celsius_units : pgmstr_fahrenheit_units;
+				uint8_t c = pgm_read_byte(from_text);
+				while (buffer + buffer_size > ++end && c) {
+					*end = c;
+					c = pgm_read_byte(++from_text);
+				}
+				return end;
+			}
+			default:
+				return end;
+		}
 	}
 
-	void Base::invoke() {
-	}
 
-	void Base::leave() {
-	}
+	/*** UI::Menu ***/
 
-	Base* Base::process_events(__attribute__((unused)) uint8_t events) {
-		return nullptr;
-	}
+	// labels of the visible items, scrolling shifts them and renders only
+	// the lines coming into view
+	static char menu_labels[DISPLAY_LINES][DISPLAY_CHARS];
 
-	Base* Base::in_menu_action() {
-		// go to next level
-		return nullptr;
+	static uint8_t menu_lines(const item_t& item) {
+		return item.max < DISPLAY_LINES ? item.max : DISPLAY_LINES;
 	}
 
-
-	// UI::Text
-	Text::Text(const char* label) :
-		Base(label, 0)
-	{}
-
-	Base* Text::in_menu_action() {
-		// stay in menu
-		return this;
+	static void menu_render(const item_t& item, uint8_t line) {
+		// buffer is one byte shorter (we are printing from position 1, not 0)
+		get_menu_label(read_child(item, line + menu_position.offset), menu_labels[line], DISPLAY_CHARS);
 	}
 
-
-	// UI:SN
-	SN::SN(const char* label) :
-		Text(label)
-	{}
-
-	char* SN::get_menu_label(char* buffer, uint8_t buffer_size) {
-		char* end = Base::get_menu_label(buffer, buffer_size);
-		int8_t size = buffer + buffer_size - end;
-		return strncpy_P(end, pgmstr_serial_number, size < SN_LENGTH ? size : SN_LENGTH);
+	static void menu_print(uint8_t line) {
+		lcd.setCursor(0, line);
+		if (line == menu_position.cursor)
+			lcd.write('>');
+		else
+			lcd.write(' ');
+		lcd.print(menu_labels[line]);
 	}
 
-
-	// UI:Live_value
-	template<class T>
-	Live_value<T>::Live_value(const char* label, T& value) :
-		Text(label), value(value)
-	{}
-
-	template<class T>
-	char* Live_value<T>::get_menu_label(char* buffer, uint8_t buffer_size) {
-		char* end = Base::get_menu_label(buffer, buffer_size);
-		int8_t size = buffer + buffer_size - end;
-		if (size < 0) {
-			size = 0;
+	static void menu_show(const item_t& item) {
+		for (uint8_t i = 0; i < menu_lines(item); ++i) {
+			menu_render(item, i);
+			menu_print(i);
 		}
-		buffer_init(end, size);
-		print(value);
-		return get_position();
-	}
-
-	template class Live_value<uint16_t>;
-	template class Live_value<float>;
-
-
-	// UI::Menu
-	Menu::Menu(const char* label, Base* const* items, uint8_t items_count) :
-		Base(label), items(items), long_press_ui_item(nullptr), items_count(items_count), menu_offset(0), cursor_position(0)
-	{
-		max_items = items_count < DISPLAY_LINES ? items_count : DISPLAY_LINES;
 	}
 
-	void Menu::invoke() {
-		cursor_position = 0;
-		Base::invoke();
+	static void menu_update(const item_t& item, menu_position_t old) {
+		uint8_t lines = menu_lines(item);
+		if (menu_position.offset == old.offset) {
+			lcd.setCursor(0, old.cursor);
+			lcd.write(' ');
+			lcd.setCursor(0, menu_position.cursor);
+			lcd.write('>');
+			return;
+		}
+		if (menu_position.offset > old.offset) {
+			uint8_t shift = menu_position.offset - old.offset;
+			if (shift >= lines) {
+				menu_show(item);
+				return;
+			}
+			memmove(menu_labels[0], menu_labels[shift], (lines - shift) * DISPLAY_CHARS);
+			for (uint8_t i = lines - shift; i < lines; ++i)
+				menu_render(item, i);
+		} else {
+			uint8_t shift = old.offset - menu_position.offset;
+			if (shift >= lines) {
+				menu_show(item);
+				return;
+			}
+			memmove(menu_labels[shift], menu_labels[0], (lines - shift) * DISPLAY_CHARS);
+			for (uint8_t i = 0; i < shift; ++i)
+				menu_render(item, i);
+		}
+		// the display has no vertical scroll, its shadow sends the changed cells
+		for (uint8_t i = 0; i < lines; ++i)
+			menu_print(i);
+	}
+
+	static void menu_control_up(const item_t& item, uint8_t steps) {
+		uint8_t max_items = menu_lines(item);
+		menu_position_t old = menu_position;
+		for (; steps; --steps) {
+			if (menu_position.cursor < max_items - 1) {
+				++menu_position.cursor;
+			} else if (menu_position.offset < item.max - DISPLAY_LINES) {
+				++menu_position.offset;
+			} else {
+				break;
+			}
+		}
+		if (menu_position.offset != old.offset || menu_position.cursor != old.cursor)
+			menu_update(item, old);
 	}
 
-	void Menu::show() {
-		// buffer is one byte shorter (we are printing from position 1, not 0)
-		char buffer[DISPLAY_CHARS];
-		for (uint8_t i = 0; i < max_items; ++i) {
-			lcd.setCursor(0, i);
-			if (i == cursor_position)
-				lcd.write('>');
-			else
-				lcd.write(' ');
-			Base* item = (Base*)pgm_read_word(&(items[i + menu_offset]));
-			item->get_menu_label(buffer, sizeof(buffer));
-			lcd.print(buffer);
+	static void menu_control_down(const item_t& item, uint8_t steps) {
+		menu_position_t old = menu_position;
+		for (; steps; --steps) {
+			if (menu_position.cursor) {
+				--menu_position.cursor;
+			} else if (menu_position.offset) {
+				--menu_position.offset;
+			} else {
+				break;
+			}
 		}
+		if (menu_position.offset != old.offset || menu_position.cursor != old.cursor)
+			menu_update(item, old);
 	}
 
-	Base* Menu::process_events(uint8_t events) {
-		if (events & (EVENT_TANK_INSERTED | EVENT_TANK_REMOVED))
-			show();
-		if (events & EVENT_CONTROL_UP)
-			event_control_up();
-		if (events & EVENT_CONTROL_DOWN)
-			event_control_down();
-		if (events & EVENT_BUTTON_SHORT_PRESS)
-			return event_button_short_press();
-		if (events & EVENT_BUTTON_LONG_PRESS)
-			return long_press_ui_item;
-		return nullptr;
+	static void temperature_units_change(const item_t* from, bool SI) {
+		item_t item;
+		read_item(from, item);
+		uint8_t& value = *(uint8_t*)item.value;
+		if (SI) {
+			value = (fahrenheit2celsius(value * 10) + 5) / 10;
+		} else {
+			value = (celsius2fahrenheit(value * 10) + 5) / 10;
+		}
+		write_config(&value, 1);
+	}
+
+	//! @return item itself to stay in menu, other item to go to, nullptr to enter item
+	static const item_t* in_menu_action(const item_t* from) {
+		item_t item;
+		read_item(from, item);
+		switch (item.type) {
+			case ITEM_TEXT:
+			case ITEM_SN:
+			case ITEM_LIVE_U16:
+			case ITEM_LIVE_I16:
+				return from;
+			case ITEM_SI_SWITCH:
+				for (uint8_t i = 0; i < item.max; ++i) {
+					temperature_units_change(read_child(item, i), !*(uint8_t*)item.value);
+				}
+				// fall through
+			case ITEM_BOOL:
+				*(uint8_t*)item.value = !*(uint8_t*)item.value;
+				write_config(item.value, 1);
+				return from;
+			case ITEM_PAUSE:
+				States::active_state->pause_continue();
+				return item.link;
+			default:
+				return nullptr;
+		}
 	}
 
-	Base* Menu::event_button_short_press() {
-		Base* item = (Base*)pgm_read_word(&(items[menu_offset + cursor_position]));
-		Base* menu_action = item->in_menu_action();
+	static const item_t* menu_button_short_press(const item_t& item) {
+		const item_t* child = read_child(item, menu_position.offset + menu_position.cursor);
+		const item_t* menu_action = in_menu_action(child);
 		if (menu_action) {
-			if (menu_action == item) {
-				show();
+			if (menu_action == child) {
+				menu_show(item);
 				return nullptr;
 			} else {
 				return menu_action;
 			}
 		} else {
-			return item;
-		}
-	}
-
-	void Menu::event_control_up() {
-		if (cursor_position < max_items - 1) {
-			++cursor_position;
-			show();
-		} else if (menu_offset < items_count - DISPLAY_LINES) {
-			++menu_offset;
-			show();
-		}
-	}
-
-	void Menu::event_control_down() {
-		if (cursor_position) {
-			--cursor_position;
-			show();
-		} else if (menu_offset) {
-			--menu_offset;
-			show();
+			return child;
 		}
 	}
 
-	void Menu::set_long_press_ui_item(Base *ui_item) {
-		long_press_ui_item = ui_item;
-	}
-
-
-	// UI::Hold_platform
-	Hold_platform::Hold_platform(const char* label, Base* const* items, uint8_t items_count) :
-		Menu(label, items, items_count)
-	{}
-
-	void Hold_platform::show() {
-		Menu::show();
-		hw.enable_stepper();
-	}
-
-	void Hold_platform::leave() {
-		Menu::leave();
-		hw.disable_stepper();
-	}
-
-
-	// UI::Menu_self_redraw
-	Menu_self_redraw::Menu_self_redraw(const char* label, Base* const* items, uint8_t items_count, uint16_t redraw_us) :
-		Menu(label, items, items_count), redraw_us(redraw_us), us_last(0)
-	{}
-
-	void Menu_self_redraw::show() {
-		us_last = millis();
-		Menu::show();
-	}
-
-	void Menu_self_redraw::loop() {
-		unsigned long us_now = millis();
-		if (us_now - us_last > redraw_us) {
-			us_last = us_now;
-			show();
-		}
-		Menu::loop();
-	}
-
-
-	// UI::Value
-	Value::Value(const char* label, uint8_t& value, const char* units, uint8_t max, uint8_t min) :
-		Base(label), units(units), value(value), max_value(max), min_value(min)
-	{}
-
-	void Value::show() {
-		lcd.print_P(label, 1, 0);
-		lcd.print(value, 5, 2);
-		lcd.print_P(units);
-	}
-
-	Base* Value::process_events(uint8_t events) {
+	static const item_t* menu_process_events(const item_t& item, uint8_t events) {
+		if (events & (EVENT_TANK_INSERTED | EVENT_TANK_REMOVED))
+			menu_show(item);
 		if (events & EVENT_CONTROL_UP)
-			event_control_up();
+			menu_control_up(item, hw.control_detents);
 		if (events & EVENT_CONTROL_DOWN)
-			event_control_down();
-		if (events & EVENT_BUTTON_SHORT_PRESS) {
-			write_config();
-			return this;
-		}
+			menu_control_down(item, hw.control_detents);
+		if (events & EVENT_BUTTON_SHORT_PRESS)
+			return menu_button_short_press(item);
+		if (events & EVENT_BUTTON_LONG_PRESS)
+			return item.link;
 		return nullptr;
 	}
 
-	void Value::event_control_up() {
-		if (value < max_value) {
-			value++;
-			show();
-		}
-	}
-
-	void Value::event_control_down() {
-		if (value > min_value) {
-			value--;
-			show();
-		}
-	}
-
-	X_of_ten::X_of_ten(const char* label, uint8_t& value) :
-		Value(label, value, pgmstr_xoften, 10)
-	{}
-
-	Minutes::Minutes(const char* label, uint8_t& value, uint8_t max) :
-		Value(label, value, pgmstr_minutes, max)
-	{}
-
-	Percent::Percent(const char* label, uint8_t& value, uint8_t min) :
-		Value(label, value, pgmstr_percent, 100, min)
-	{}
-
-	Temperature::Temperature(const char* label, uint8_t& value) :
-		Value(label, value, pgmstr_celsius, MAX_TARGET_TEMP_C, MIN_TARGET_TEMP_C)
-	{}
 
-	// config may be readed after constructor
-	void Temperature::init(bool SI) {
-		if (SI) {
-			units = pgmstr_celsius;
-			max_value = MAX_TARGET_TEMP_C;
-			min_value = MIN_TARGET_TEMP_C;
-		} else {
-			units = pgmstr_fahrenheit;
-			max_value = MAX_TARGET_TEMP_F;
-			min_value = MIN_TARGET_TEMP_F;
-		}
-	}
+	/*** UI::Value ***/
 
-	void Temperature::units_change(bool SI) {
-		init(SI);
-		if (SI) {
-			value = round(fahrenheit2celsius(value));
-		} else {
-			value = round(celsius2fahrenheit(value));
+	static void value_limits(item_t& item) {
+		if (item.type == ITEM_TEMPERATURE) {
+			if (config.SI_unit_system) {
+				item.units = pgmstr_celsius;
+			} else {
+				item.units = pgmstr_fahrenheit;
+				item.max = MAX_TARGET_TEMP_F;
+				item.min = MIN_TARGET_TEMP_F;
+			}
 		}
 	}
 
-
-	// UI::Percent_with_action
-	Percent_with_action::Percent_with_action(const char* label, uint8_t& value, uint8_t min, void (*value_setter)(uint8_t)) :
-		Percent(label, value, min), value_setter(value_setter)
-	{}
-
-	void Percent_with_action::event_control_up() {
-		Percent::event_control_up();
-		value_setter(value);
+	static void value_show(const item_t& item) {
+		lcd.print_P(item.label, 1, 0);
+		lcd.print(*(uint8_t*)item.value, 5, 2);
+		lcd.print_P(item.units);
 	}
 
-	void Percent_with_action::event_control_down() {
-		Percent::event_control_down();
-		value_setter(value);
+	// a detent moves at most a tenth of the range, short ranges don't accelerate
+	static uint8_t accelerated_steps(const item_t& item) {
+		uint8_t limit = (item.max - item.min) / 10;
+		if (!limit)
+			return hw.control_detents;
+		uint16_t steps = hw.control_detents * limit;
+		return hw.control_steps < steps ? hw.control_steps : steps;
 	}
 
-
-	// UI::Bool
-	Bool::Bool(const char* label, uint8_t& value, const char* true_text, const char* false_text) :
-		Base(label, 0), true_text(true_text), false_text(false_text), value(value)
-	{}
-
-	char* Bool::get_menu_label(char* buffer, uint8_t buffer_size) {
-		char* end = Base::get_menu_label(buffer, buffer_size);
-		const char* from = value ? true_text : false_text;
-		uint8_t c = pgm_read_byte(from);
-		while (buffer + buffer_size > ++end && c) {
-			*end = c;
-			c = pgm_read_byte(++from);
+	static const item_t* value_process_events(const item_t* from, const item_t& item, uint8_t events) {
+		uint8_t& value = *(uint8_t*)item.value;
+		uint8_t old_value = value;
+		if (events & EVENT_CONTROL_UP) {
+			uint8_t steps = accelerated_steps(item);
+			value = item.max - value > steps ? value + steps : item.max;
 		}
-		return end;
-	}
-
-	Base* Bool::in_menu_action() {
-		value = !value;
-		write_config();
-		return this;
-	}
-
-
-	// UI::SI_switch
-	SI_switch::SI_switch(const char* label, uint8_t& value, Temperature* const* to_change, uint8_t to_change_count) :
-		Bool(label, value, pgmstr_celsius_units, pgmstr_fahrenheit_units), to_change(to_change), to_change_count(to_change_count)
-	{}
-
-	Base* SI_switch::in_menu_action() {
-		for (uint8_t i = 0; i < to_change_count; ++i) {
-			Temperature* item = (Temperature*)pgm_read_word(&(to_change[i]));
-			item->units_change(!value);
+		if (events & EVENT_CONTROL_DOWN) {
+			uint8_t steps = accelerated_steps(item);
+			value = value - item.min > steps ? value - steps : item.min;
+		}
+		if (value != old_value) {
+			value_show(item);
+			if (item.action)
+				item.action(value);
+		}
+		if (events & EVENT_BUTTON_SHORT_PRESS) {
+			write_config(item.value, 1);
+			return from;
 		}
-		Bool::in_menu_action();
-		return this;
+		return nullptr;
 	}
 
 
-	// UI::Option
-	Option::Option(const char* label, uint8_t& value, const char* const* options, uint8_t options_count) :
-		Base(label), value(value), options(options), options_count(options_count)
-	{
-		if (value > options_count)
-			value = 0;
-	}
+	/*** UI::Option ***/
 
-	void Option::show() {
-		lcd.print_P(label, 1, 0);
+	static void option_show(const item_t& item) {
+		uint8_t& value = *(uint8_t*)item.value;
+		if (value >= item.max)
+			value = 0;
+		lcd.print_P(item.label, 1, 0);
 		lcd.clearLine(2);
-		const char* option = (const char*)pgm_read_word(&(options[value]));
+		const char* option = (const char*)pgm_read_ptr(&((const char* const*)item.items)[value]);
 		uint8_t len = strlen_P(option);
 		if (value)
 			len += 2;
-		if (value < options_count - 1)
+		if (value < item.max - 1)
 			len += 2;
 		lcd.setCursor((20 - len) / 2, 2);
 		if (value)
 			lcd.print_P(pgmstr_lt);
 		lcd.print_P(option);
-		if (value < options_count - 1)
+		if (value < item.max - 1)
 			lcd.print_P(pgmstr_gt);
 	}
 
-	Base* Option::process_events(uint8_t events) {
-		if (events & EVENT_CONTROL_UP)
-			event_control_up();
-		if (events & EVENT_CONTROL_DOWN)
-			event_control_down();
-		if (events & EVENT_BUTTON_SHORT_PRESS) {
-			write_config();
-			return this;
+	static const item_t* option_process_events(const item_t* from, const item_t& item, uint8_t events) {
+		uint8_t& value = *(uint8_t*)item.value;
+		uint8_t steps = hw.control_detents;
+		if (events & EVENT_CONTROL_UP && value < item.max - 1) {
+			value = item.max - 1 - value > steps ? value + steps : item.max - 1;
+			option_show(item);
 		}
-		return nullptr;
-	}
-
-	void Option::event_control_up() {
-		if (value < options_count - 1) {
-			value++;
-			show();
+		if (events & EVENT_CONTROL_DOWN && value) {
+			value = value > steps ? value - steps : 0;
+			option_show(item);
 		}
-	}
-
-	void Option::event_control_down() {
-		if (value) {
-			value--;
-			show();
+		if (events & EVENT_BUTTON_SHORT_PRESS) {
+			write_config(item.value, 1);
+			return from;
 		}
+		return nullptr;
 	}
 
 
-	// UI::State
-	State::State(const char* label, States::Base* state, Base* state_menu) :
-		Base(label, PLAY_CHAR),
-		state(state),
-		state_menu(state_menu),
-		old_title(nullptr),
-		old_message(nullptr),
-		old_time(UINT16_MAX),
-		spin_us_last(0),
-		bound_us_last(0),
-		spin_count(0)
-	{}
+	/*** UI::State ***/
 
-	void State::show() {
+	static void state_show() {
 		old_title = nullptr;
 		old_message = nullptr;
 		old_time = UINT16_MAX;
-		spin_us_last = 0;
 		bound_us_last = 0;
 		spin_count = 0;
-		Base::show();
 	}
 
-	void State::loop() {
+	static void clear_time_boundaries() {
+		lcd.print_P(pgmstr_double_space, LAYOUT_TIME_GT, LAYOUT_TIME_Y);
+		lcd.print_P(pgmstr_double_space, LAYOUT_TIME_LT, LAYOUT_TIME_Y);
+	}
+
+	static void state_loop() {
 		const char* tmp_str = States::active_state->get_title();
 		if (tmp_str != old_title) {
 			lcd.clear();
@@ -436,8 +419,7 @@ namespace UI {
 				lcd.setCursor(19, 0);
 				uint8_t c = pgm_read_byte(pgmstr_progress + spin_count);
 				lcd.write(c);
-				if (us_now - spin_us_last > 100) {
-					spin_us_last = us_now;
+				if (Scheduler::due(Scheduler::TASK_SPINNER)) {
 					if (++spin_count >= sizeof(pgmstr_progress)) {
 						spin_count = 0;
 					}
@@ -453,7 +435,7 @@ namespace UI {
 				old_time = time;
 				lcd.printTime(time, LAYOUT_TIME_X, LAYOUT_TIME_Y);
 				// temperature
-				float temp = States::active_state->get_temperature();
+				int16_t temp = States::active_state->get_temperature();
 				if (temp > 0) {
 					lcd.print(temp, LAYOUT_INFO1_X, LAYOUT_INFO1_Y);
 					lcd.print_P(config.SI_unit_system ? pgmstr_celsius : pgmstr_fahrenheit);
@@ -471,134 +453,149 @@ namespace UI {
 		}
 	}
 
-	void State::invoke() {
-		States::change(state);
-		Base::invoke();
-	}
-
-	void State::leave() {
-		States::change(&States::menu);
-		Base::leave();
+	static void state_control(bool up, uint8_t steps) {
+		if (States::active_state->get_time() != UINT16_MAX) {
+			clear_time_boundaries();
+			const char* symbol = nullptr;
+			for (; steps; --steps)
+				symbol = up ? States::active_state->increase_time() : States::active_state->decrease_time();
+			if (symbol) {
+				lcd.print_P(symbol, up ? LAYOUT_TIME_GT : LAYOUT_TIME_LT, LAYOUT_TIME_Y);
+				bound_us_last = millis();
+			}
+		}
 	}
 
-	Base* State::process_events(uint8_t events) {
+	static const item_t* state_process_events(const item_t& item, uint8_t events) {
 		if (events & (EVENT_COVER_OPENED | EVENT_COVER_CLOSED | EVENT_TANK_INSERTED | EVENT_TANK_REMOVED))
 			old_time = UINT16_MAX;
 		if (events & EVENT_CONTROL_UP)
-			event_control_up();
+			state_control(true, hw.control_detents);
 		if (events & EVENT_CONTROL_DOWN)
-			event_control_down();
-		if (events & EVENT_BUTTON_SHORT_PRESS)
-			return event_button_short_press();
+			state_control(false, hw.control_detents);
+		if (events & EVENT_BUTTON_SHORT_PRESS) {
+			if (States::active_state->short_press_cancel()) {
+				States::active_state->cancel();
+				return nullptr;
+			}
+			return item.link;
+		}
 		if (events & EVENT_BUTTON_LONG_PRESS)
 			States::active_state->cancel();
 		return nullptr;
 	}
 
-	Base* State::event_button_short_press() {
-		if (States::active_state->short_press_cancel()) {
-			States::active_state->cancel();
-			return nullptr;
+	static States::Base* do_it_state(uint8_t curing_machine_mode) {
+		if (hw.is_tank_inserted())
+			return &States::washing;
+		switch (curing_machine_mode) {
+			case 2:
+				States::drying.set_continue_to(&States::confirm);
+				States::warmup_print.set_continue_to(&States::drying);
+				break;
+			case 1:
+				States::warmup_print.set_continue_to(&States::curing);
+				break;
+			default:
+				States::drying.set_continue_to(&States::curing);
+				States::warmup_print.set_continue_to(&States::drying);
+				break;
 		}
-		return state_menu;
-	}
-
-	void State::event_control_up() {
-		if (States::active_state->get_time() != UINT16_MAX) {
-			clear_time_boundaries();
-			const char* symbol = States::active_state->increase_time();
-			if (symbol) {
-				lcd.print_P(symbol, LAYOUT_TIME_GT, LAYOUT_TIME_Y);
-				bound_us_last = millis();
-			}
+		return &States::warmup_print;
+	}
+
+
+	/*** interpreter ***/
+
+	void show(const item_t* from) {
+		item_t item;
+		read_item(from, item);
+		switch (item.type) {
+			case ITEM_HOLD_PLATFORM:
+				menu_show(item);
+				hw.enable_stepper();
+				break;
+			case ITEM_MENU:
+			case ITEM_SELF_REDRAW:
+				menu_show(item);
+				break;
+			case ITEM_VALUE:
+			case ITEM_TEMPERATURE:
+				value_limits(item);
+				value_show(item);
+				break;
+			case ITEM_OPTION:
+				option_show(item);
+				break;
+			case ITEM_STATE:
+			case ITEM_DO_IT:
+				state_show();
+				break;
+			default:
+				break;
 		}
 	}
 
-	void State::event_control_down() {
-		if (States::active_state->get_time() != UINT16_MAX) {
-			clear_time_boundaries();
-			const char* symbol = States::active_state->decrease_time();
-			if (symbol) {
-				lcd.print_P(symbol, LAYOUT_TIME_LT, LAYOUT_TIME_Y);
-				bound_us_last = millis();
-			}
+	void loop(const item_t* from) {
+		switch (pgm_read_byte(&from->type)) {
+			case ITEM_SELF_REDRAW:
+				if (Scheduler::due(Scheduler::TASK_REDRAW)) {
+					show(from);
+				}
+				break;
+			case ITEM_STATE:
+			case ITEM_DO_IT:
+				state_loop();
+				break;
+			default:
+				break;
 		}
 	}
 
-	void State::clear_time_boundaries() {
-		lcd.print_P(pgmstr_double_space, LAYOUT_TIME_GT, LAYOUT_TIME_Y);
-		lcd.print_P(pgmstr_double_space, LAYOUT_TIME_LT, LAYOUT_TIME_Y);
-	}
-
-
-	// UI::Do_it
-	Do_it::Do_it(uint8_t& curing_machine_mode, Base* state_menu) :
-		State(nullptr, nullptr, state_menu), curing_machine_mode(curing_machine_mode)
-	{}
-
-	char* Do_it::get_menu_label(char* buffer, uint8_t buffer_size) {
-		if (hw.is_tank_inserted()) {
-			label = pgmstr_washing;
-		} else {
-			switch (curing_machine_mode) {
-				case 2:
-					label = pgmstr_drying;
-					break;
-				case 1:
-					label = pgmstr_curing;
-					break;
-				default:
-					label = pgmstr_drying_curing;
-					break;
-			}
+	void invoke(const item_t* from) {
+		item_t item;
+		read_item(from, item);
+		if (is_menu(item)) {
+			menu_position = {0, 0};
+		} else if (item.type == ITEM_STATE) {
+			States::change((States::Base*)item.value);
+		} else if (item.type == ITEM_DO_IT) {
+			States::change(do_it_state(*(uint8_t*)item.value));
 		}
-		return State::get_menu_label(buffer, buffer_size);
 	}
 
-	void Do_it::invoke() {
-		if (hw.is_tank_inserted()) {
-			state = &States::washing;
-		} else {
-			switch (curing_machine_mode) {
-				case 2:
-					States::drying.set_continue_to(&States::confirm);
-					States::warmup_print.set_continue_to(&States::drying);
-					break;
-				case 1:
-					States::warmup_print.set_continue_to(&States::curing);
-					break;
-				default:
-					States::drying.set_continue_to(&States::curing);
-					States::warmup_print.set_continue_to(&States::drying);
-					break;
-			}
-			state = &States::warmup_print;
+	void leave(const item_t* from) {
+		switch (pgm_read_byte(&from->type)) {
+			case ITEM_HOLD_PLATFORM:
+				hw.disable_stepper();
+				break;
+			case ITEM_STATE:
+			case ITEM_DO_IT:
+				States::change(&States::menu);
+				break;
+			default:
+				break;
 		}
-		State::invoke();
 	}
 
-
-	// UI::Pause
-	Pause::Pause(Base* back) :
-		Base(pgmstr_emptystr), back(back)
-	{}
-
-	char* Pause::get_menu_label(char* buffer, uint8_t buffer_size) {
-		buffer[--buffer_size] = char(0);	// end of text
-		memset(buffer, ' ', buffer_size++);
-		const char* from = States::active_state->is_paused() ? pgmstr_continue : pgmstr_pause;
-		uint8_t c = pgm_read_byte(from);
-		while (--buffer_size && c) {
-			*buffer = c;
-			++buffer;
-			c = pgm_read_byte(++from);
+	const item_t* process_events(const item_t* from, uint8_t events) {
+		item_t item;
+		read_item(from, item);
+		if (is_menu(item))
+			return menu_process_events(item, events);
+		switch (item.type) {
+			case ITEM_VALUE:
+			case ITEM_TEMPERATURE:
+				value_limits(item);
+				return value_process_events(from, item, events);
+			case ITEM_OPTION:
+				return option_process_events(from, item, events);
+			case ITEM_STATE:
+			case ITEM_DO_IT:
+				return state_process_events(item, events);
+			default:
+				return nullptr;
 		}
-		return buffer;
-	}
-
-	Base* Pause::in_menu_action() {
-		States::active_state->pause_continue();
-		return back;
 	}
 
 }
@@ -3,230 +3,144 @@
 #include "hardware.h"
 #include "i18n.h"
 #include "states_items.h"
-#include "simple_print.h"
+
+// Menu items are constant descriptors in PROGMEM, built at compile time by the
+// functions below (named after the item kinds). The interpreter in
+// ui_items.cpp gives them behaviour by their type, only the active item keeps
+// its state in RAM (menu position, state screen).
 
 namespace UI {
 
-	// UI::Base
-	class Base {
-	public:
-		Base(const char* label, uint8_t last_char = RIGHT_CHAR);
-		virtual char* get_menu_label(char* buffer, uint8_t buffer_size);
-		virtual void show();
-		virtual void loop();
-		virtual void invoke();
-		virtual void leave();
-		virtual Base* process_events(uint8_t events);
-		virtual Base* in_menu_action();
-	protected:
+	enum item_type_t : uint8_t {
+		ITEM_BACK,			// leaves the menu
+		ITEM_STOP,			// leaves all menus
+		ITEM_TEXT,			// label only
+		ITEM_SN,			// label and serial number
+		ITEM_LIVE_U16,		// label and uint16_t value
+		ITEM_LIVE_I16,		// label and int16_t value (deci-degrees)
+		ITEM_MENU,			// items
+		ITEM_HOLD_PLATFORM,	// menu keeping the stepper enabled
+		ITEM_SELF_REDRAW,	// menu redrawn periodically
+		ITEM_VALUE,			// value in min..max with units
+		ITEM_TEMPERATURE,	// value in celsius or fahrenheit by config.SI_unit_system
+		ITEM_BOOL,			// value toggled in menu
+		ITEM_SI_SWITCH,		// bool converting temperature items on change
+		ITEM_OPTION,		// value indexes options
+		ITEM_STATE,			// runs state, link is the menu of short press
+		ITEM_DO_IT,			// state chosen by value (curing machine mode) and tank
+		ITEM_PAUSE,			// pauses or continues active state, back to link
+	};
+
+	struct item_t {
+		item_type_t type;
+		uint8_t max;				// value maximum, count of items
+		uint8_t min;				// value minimum
 		const char* label;
-		uint8_t last_char;
+		const char* units;
+		void* value;				// uint8_t, uint16_t, int16_t or States::Base
+		const void* items;			// item_t* const[] or const char* const[]
+		const item_t* link;			// long press item of menu, menu of state, back of pause
+		void (*action)(uint8_t);	// called with new value
 	};
 
-
-	// UI::Text
-	class Text : public Base {
-	public:
-		Text(const char* label);
-		Base* in_menu_action();
+	struct menu_position_t {
+		uint8_t offset;
+		uint8_t cursor;
 	};
 
+	// of the active menu, saved with the menu stack
+	extern menu_position_t menu_position;
 
-	// UI:SN
-	class SN : public Text {
-	public:
-		SN(const char* label);
-		char* get_menu_label(char* buffer, uint8_t buffer_size);
-	};
+	// interpreter
+	char* get_menu_label(const item_t* item, char* buffer, uint8_t buffer_size);
+	void show(const item_t* item);
+	void loop(const item_t* item);
+	void invoke(const item_t* item);
+	void leave(const item_t* item);
+	const item_t* process_events(const item_t* item, uint8_t events);
 
 
-	// UI:Live_value
-	template<class T>
-	class Live_value : public Text, public SimplePrint {
-	public:
-		Live_value(const char* label, T& value);
-		char* get_menu_label(char* buffer, uint8_t buffer_size);
-	private:
-		T& value;
-	};
+	/*** descriptors ***/
 
+	constexpr item_t Back(const char* label) {
+		return {ITEM_BACK, 0, 0, label, nullptr, nullptr, nullptr, nullptr, nullptr};
+	}
 
-	// UI::Menu
-	class Menu : public Base {
-	public:
-		Menu(const char* label, Base* const* items, uint8_t items_count);
-		void show();
-		void invoke();
-		Base* process_events(uint8_t events);
-		void set_long_press_ui_item(Base *ui_item);
-	private:
-		Base* event_button_short_press();
-		void event_control_up();
-		void event_control_down();
-		Base* const* const items;
-		Base* long_press_ui_item;
-		uint8_t const items_count;
-		uint8_t menu_offset;
-		uint8_t cursor_position;
-		uint8_t max_items;
-	};
+	constexpr item_t Stop(const char* label) {
+		return {ITEM_STOP, 0, 0, label, nullptr, nullptr, nullptr, nullptr, nullptr};
+	}
 
+	constexpr item_t Text(const char* label) {
+		return {ITEM_TEXT, 0, 0, label, nullptr, nullptr, nullptr, nullptr, nullptr};
+	}
 
-	// UI:Hold_platform
-	class Hold_platform : public Menu {
-	public:
-		Hold_platform(const char* label, Base* const* items, uint8_t items_count);
-		void show();
-		void leave();
-	};
+	constexpr item_t SN(const char* label) {
+		return {ITEM_SN, 0, 0, label, nullptr, nullptr, nullptr, nullptr, nullptr};
+	}
 
+	constexpr item_t Live_value(const char* label, uint16_t& value) {
+		return {ITEM_LIVE_U16, 0, 0, label, nullptr, &value, nullptr, nullptr, nullptr};
+	}
 
-	// UI::Menu_self_redraw
-	class Menu_self_redraw : public Menu {
-	public:
-		Menu_self_redraw(const char* label, Base* const* items, uint8_t items_count, uint16_t redraw_us);
-		void show();
-		void loop();
-	private:
-		uint16_t redraw_us;
-		unsigned long us_last;
-	};
+	constexpr item_t Live_value(const char* label, int16_t& value) {
+		return {ITEM_LIVE_I16, 0, 0, label, nullptr, &value, nullptr, nullptr, nullptr};
+	}
 
+	constexpr item_t Menu(const char* label, const item_t* const* items, uint8_t items_count, const item_t* long_press_item = nullptr) {
+		return {ITEM_MENU, items_count, 0, label, nullptr, nullptr, items, long_press_item, nullptr};
+	}
 
-	// UI::Value
-	class Value : public Base {
-	public:
-		Value(const char* label, uint8_t& value, const char* units, uint8_t max, uint8_t min = 1);
-		void show();
-		Base* process_events(uint8_t events);
-	protected:
-		virtual void event_control_up();
-		virtual void event_control_down();
-		const char* units;
-		uint8_t& value;
-		uint8_t max_value;
-		uint8_t min_value;
-	};
+	constexpr item_t Hold_platform(const char* label, const item_t* const* items, uint8_t items_count) {
+		return {ITEM_HOLD_PLATFORM, items_count, 0, label, nullptr, nullptr, items, nullptr, nullptr};
+	}
 
-	class X_of_ten : public Value {
-	public:
-		X_of_ten(const char* label, uint8_t& value);
-	};
+	constexpr item_t Menu_self_redraw(const char* label, const item_t* const* items, uint8_t items_count) {
+		return {ITEM_SELF_REDRAW, items_count, 0, label, nullptr, nullptr, items, nullptr, nullptr};
+	}
 
-	class Minutes : public Value {
-	public:
-		Minutes(const char* label, uint8_t& value, uint8_t max = 10);
-	};
+	constexpr item_t Value(const char* label, uint8_t& value, const char* units, uint8_t max, uint8_t min = 1, void (*action)(uint8_t) = nullptr) {
+		return {ITEM_VALUE, max, min, label, units, &value, nullptr, nullptr, action};
+	}
 
-	class Percent : public Value {
-	public:
-		Percent(const char* label, uint8_t& value, uint8_t min = 0);
-	};
+	constexpr item_t X_of_ten(const char* label, uint8_t& value) {
+		return Value(label, value, pgmstr_xoften, 10);
+	}
 
-	class Temperature : public Value {
-	public:
-		Temperature(const char* label, uint8_t& value);
-		void init(bool SI);
-		void units_change(bool SI);
-	};
+	constexpr item_t Minutes(const char* label, uint8_t& value, uint8_t max = 10) {
+		return Value(label, value, pgmstr_minutes, max);
+	}
 
+	constexpr item_t Percent(const char* label, uint8_t& value, uint8_t min = 0, void (*action)(uint8_t) = nullptr) {
+		return Value(label, value, pgmstr_percent, 100, min, action);
+	}
 
-	// UI:Percent_with_action
-	class Percent_with_action : public Percent {
-	public:
-		Percent_with_action(const char* label, uint8_t& value, uint8_t min, void (*value_setter)(uint8_t));
-	protected:
-		void event_control_up();
-		void event_control_down();
-	private:
-		void (*value_setter)(uint8_t);
-	};
+	// limits are celsius, fahrenheit ones are derived
+	constexpr item_t Temperature(const char* label, uint8_t& value) {
+		return {ITEM_TEMPERATURE, MAX_TARGET_TEMP_C, MIN_TARGET_TEMP_C, label, nullptr, &value, nullptr, nullptr, nullptr};
+	}
 
+	constexpr item_t Bool(const char* label, uint8_t& value) {
+		return {ITEM_BOOL, 0, 0, label, nullptr, &value, nullptr, nullptr, nullptr};
+	}
 
-	// UI:Bool
-	class Bool : public Base {
-	public:
-		Bool(const char* label, uint8_t& value, const char* true_text = pgmstr_on, const char* false_text = pgmstr_off);
-		char* get_menu_label(char* buffer, uint8_t buffer_size);
-		Base* in_menu_action();
-	protected:
-		const char* true_text;
-		const char* false_text;
-		uint8_t& value;
-	};
+	constexpr item_t SI_switch(const char* label, uint8_t& value, const item_t* const* to_change, uint8_t to_change_count) {
+		return {ITEM_SI_SWITCH, to_change_count, 0, label, nullptr, &value, to_change, nullptr, nullptr};
+	}
 
+	constexpr item_t Option(const char* label, uint8_t& value, const char* const* options, uint8_t options_count) {
+		return {ITEM_OPTION, options_count, 0, label, nullptr, &value, options, nullptr, nullptr};
+	}
 
-	// UI::SI_switch
-	class SI_switch : public Bool {
-	public:
-		SI_switch(const char* label, uint8_t& value, Temperature* const* to_change, uint8_t to_change_count);
-		Base* in_menu_action();
-	private:
-		Temperature* const* to_change;
-		uint8_t to_change_count;
-	};
+	constexpr item_t State(const char* label, States::Base* state, const item_t* state_menu = nullptr) {
+		return {ITEM_STATE, 0, 0, label, nullptr, state, nullptr, state_menu, nullptr};
+	}
 
+	constexpr item_t Do_it(uint8_t& curing_machine_mode, const item_t* state_menu = nullptr) {
+		return {ITEM_DO_IT, 0, 0, nullptr, nullptr, &curing_machine_mode, nullptr, state_menu, nullptr};
+	}
 
-	// UI::Option
-	class Option : public Base {
-	public:
-		Option(const char* label, uint8_t& value, const char* const* options, uint8_t options_count);
-		void show();
-		Base* process_events(uint8_t events);
-	private:
-		void event_control_up();
-		void event_control_down();
-		uint8_t& value;
-		const char* const* options;
-		uint8_t const options_count;
-	};
-
-
-	// UI::State
-	class State : public Base {
-	public:
-		State(const char* label, States::Base* state, Base* state_menu = nullptr);
-		void show();
-		void loop();
-		void invoke();
-		void leave();
-		Base* process_events(uint8_t events);
-	protected:
-		States::Base* state;
-		Base* const state_menu;
-	private:
-		Base* event_button_short_press();
-		void event_control_up();
-		void event_control_down();
-		void clear_time_boundaries();
-		const char* old_title;
-		const char* old_message;
-		uint16_t old_time;
-		unsigned long spin_us_last;
-		unsigned long bound_us_last;
-		uint8_t spin_count;
-	};
-
-
-	// UI::Do_it
-	class Do_it : public State {
-	public:
-		Do_it(uint8_t& curing_machine_mode, Base* state_menu = nullptr);
-		char* get_menu_label(char* buffer, uint8_t buffer_size);
-		void invoke();
-	private:
-		uint8_t& curing_machine_mode;
-	};
-
-
-	// UI::Pause
-	class Pause : public Base {
-	public:
-		Pause(Base* back);
-		char* get_menu_label(char* buffer, uint8_t buffer_size);
-		Base* in_menu_action();
-	private:
-		Base* back;
-	};
+	constexpr item_t Pause(const item_t* back) {
+		return {ITEM_PAUSE, 0, 0, pgmstr_emptystr, nullptr, nullptr, nullptr, back, nullptr};
+	}
 
 }